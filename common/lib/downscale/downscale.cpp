@@ -0,0 +1,802 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include "downscale.h"
+
+#include <vector>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AREA_DOWNSCALE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define AREA_DOWNSCALE_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(ARM_NEON_ENABLE) || defined(__ARM_NEON)
+#define AREA_DOWNSCALE_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * Filter weights are fixed point numbers, the weights of every destination
+ * pixel add up to one. The vertical pass stores 8-bit pixels multiplied by
+ * the vertical weights, so the intermediate rows fit in 16-bit integers.
+ * The horizontal weights fit in signed 16-bit integers, which allows using
+ * multiply-add instructions
+ */
+#define ROW_BITS 8
+#define COLUMN_BITS 14
+#define TOTAL_BITS (ROW_BITS + COLUMN_BITS)
+
+/*
+ * Source pixels used by a single destination pixel (or row)
+ */
+struct Taps {
+    int first;
+    int count;
+    int weights;
+};
+
+/*
+ * Calculates the source pixels covered by each of the \a dst pixels and the
+ * weight of each source pixel. A destination pixel covers the interval
+ * [i * src, (i + 1) * src) measured in 1/dst source pixels.
+ *
+ * If \a uniform is set, every destination pixel gets the same (even) number
+ * of taps, the additional taps have a weight of zero
+ */
+static int compute_taps (const int src,
+                         const int dst,
+                         const int bits,
+                         const bool uniform,
+                         std::vector<Taps>& taps,
+                         std::vector<unsigned short>& weights)
+{
+    taps.resize (dst);
+    weights.clear();
+
+    /* Maximum number of source pixels covered by a destination pixel */
+    int max_count = (src + dst - 1) / dst + 1;
+    max_count += max_count % 2;
+
+    for (int i = 0; i < dst; ++i) {
+        const long long start = (long long) i * src;
+        const long long end = start + src;
+
+        Taps& tap = taps[i];
+        tap.first = (int) (start / dst);
+        tap.count = 0;
+        tap.weights = (int) weights.size();
+
+        /* Round the cumulative weight so that the weights add up to one */
+        int previous = 0;
+        for (int j = tap.first; (long long) j * dst < end; ++j) {
+            long long limit = (long long) (j + 1) * dst;
+            if (limit > end)
+                limit = end;
+
+            int cumulative = (int) ((((limit - start) << bits) + src / 2) / src);
+            weights.push_back ((unsigned short) (cumulative - previous));
+            previous = cumulative;
+            ++tap.count;
+        }
+
+        /* Pad the taps with zero weights */
+        if (uniform) {
+            for (; tap.count < max_count; ++tap.count)
+                weights.push_back (0);
+        }
+    }
+
+    return max_count;
+}
+
+/*
+ * Multiplies a source row by \a weight and adds it to (or stores it in)
+ * the intermediate row
+ */
+typedef void (*AccumulateFunc) (unsigned short* acc,
+                                unsigned char const* row,
+                                const int length,
+                                const int weight,
+                                const bool first);
+
+static void accumulate_c (unsigned short* acc,
+                          unsigned char const* row,
+                          const int length,
+                          const int weight,
+                          const bool first)
+{
+    if (first) {
+        for (int i = 0; i < length; ++i)
+            acc[i] = (unsigned short) (row[i] * weight);
+    }
+
+    else {
+        for (int i = 0; i < length; ++i)
+            acc[i] = (unsigned short) (acc[i] + row[i] * weight);
+    }
+}
+
+#ifdef AREA_DOWNSCALE_SSE2
+static void accumulate_sse2 (unsigned short* acc,
+                             unsigned char const* row,
+                             const int length,
+                             const int weight,
+                             const bool first)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16 ((short) weight);
+
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i pixels = _mm_loadu_si128 ((const __m128i*) (row + i));
+        __m128i lo = _mm_mullo_epi16 (_mm_unpacklo_epi8 (pixels, zero), w);
+        __m128i hi = _mm_mullo_epi16 (_mm_unpackhi_epi8 (pixels, zero), w);
+
+        if (!first) {
+            lo = _mm_add_epi16 (lo, _mm_loadu_si128 ((const __m128i*) (acc + i)));
+            hi = _mm_add_epi16 (hi, _mm_loadu_si128 ((const __m128i*) (acc + i + 8)));
+        }
+
+        _mm_storeu_si128 ((__m128i*) (acc + i), lo);
+        _mm_storeu_si128 ((__m128i*) (acc + i + 8), hi);
+    }
+
+    accumulate_c (acc + i, row + i, length - i, weight, first);
+}
+#endif
+
+#ifdef AREA_DOWNSCALE_AVX2
+__attribute__ ((target ("avx2")))
+static void accumulate_avx2 (unsigned short* acc,
+                             unsigned char const* row,
+                             const int length,
+                             const int weight,
+                             const bool first)
+{
+    const __m256i w = _mm256_set1_epi16 ((short) weight);
+
+    int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) (row + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (row + i + 16));
+        __m256i lo = _mm256_mullo_epi16 (_mm256_cvtepu8_epi16 (a), w);
+        __m256i hi = _mm256_mullo_epi16 (_mm256_cvtepu8_epi16 (b), w);
+
+        if (!first) {
+            lo = _mm256_add_epi16 (lo, _mm256_loadu_si256 ((const __m256i*) (acc + i)));
+            hi = _mm256_add_epi16 (hi, _mm256_loadu_si256 ((const __m256i*) (acc + i + 16)));
+        }
+
+        _mm256_storeu_si256 ((__m256i*) (acc + i), lo);
+        _mm256_storeu_si256 ((__m256i*) (acc + i + 16), hi);
+    }
+
+    accumulate_sse2 (acc + i, row + i, length - i, weight, first);
+}
+#endif
+
+#ifdef AREA_DOWNSCALE_NEON
+static void accumulate_neon (unsigned short* acc,
+                             unsigned char const* row,
+                             const int length,
+                             const int weight,
+                             const bool first)
+{
+    const uint16_t w = (uint16_t) weight;
+
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t pixels = vld1q_u8 (row + i);
+        uint16x8_t lo = vmovl_u8 (vget_low_u8 (pixels));
+        uint16x8_t hi = vmovl_u8 (vget_high_u8 (pixels));
+
+        if (first) {
+            vst1q_u16 (acc + i, vmulq_n_u16 (lo, w));
+            vst1q_u16 (acc + i + 8, vmulq_n_u16 (hi, w));
+        }
+
+        else {
+            vst1q_u16 (acc + i, vmlaq_n_u16 (vld1q_u16 (acc + i), lo, w));
+            vst1q_u16 (acc + i + 8, vmlaq_n_u16 (vld1q_u16 (acc + i + 8), hi, w));
+        }
+    }
+
+    accumulate_c (acc + i, row + i, length - i, weight, first);
+}
+#endif
+
+/*
+ * Selects the fastest vertical kernel supported by the CPU
+ */
+static AccumulateFunc select_accumulate()
+{
+#ifdef AREA_DOWNSCALE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("avx2"))
+        return accumulate_avx2;
+#endif
+
+#if defined(AREA_DOWNSCALE_SSE2)
+    return accumulate_sse2;
+#elif defined(AREA_DOWNSCALE_NEON)
+    return accumulate_neon;
+#else
+    return accumulate_c;
+#endif
+}
+
+/*
+ * Averages the intermediate row horizontally and writes the destination row,
+ * every destination pixel uses \a count taps
+ */
+static void average_row_c (unsigned char* dst,
+                           unsigned short const* acc,
+                           const int width,
+                           const int channels,
+                           const int count,
+                           const std::vector<Taps>& taps,
+                           const std::vector<unsigned short>& weights)
+{
+    const unsigned int round = 1 << (TOTAL_BITS - 1);
+
+    for (int x = 0; x < width; ++x) {
+        unsigned short const* w = &weights[taps[x].weights];
+        unsigned short const* src = acc + taps[x].first * channels;
+
+        for (int c = 0; c < channels; ++c) {
+            unsigned int sum = round;
+            for (int i = 0; i < count; ++i)
+                sum += (unsigned int) w[i] * src[i * channels + c];
+
+            *dst++ = (unsigned char) (sum >> TOTAL_BITS);
+        }
+    }
+}
+
+#if defined(AREA_DOWNSCALE_SSE2)
+/*
+ * Averages the intermediate row of a 3 or 4 channel image, each pair of taps
+ * is interleaved and multiplied with a single madd instruction, so that all
+ * the channels of a pixel are processed at once.
+ *
+ * The madd instruction works with signed numbers, so 32768 is subtracted
+ * from the intermediate values and added back (multiplied by the sum of the
+ * weights) to the rounding constant
+ */
+template <int channels>
+static void average_row_simd (unsigned char* dst,
+                              unsigned short const* acc,
+                              const int width,
+                              const int count,
+                              const std::vector<Taps>& taps,
+                              const std::vector<unsigned short>& weights)
+{
+    const __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+    const __m128i round = _mm_set1_epi32 ((1 << (TOTAL_BITS - 1)) +
+                                          (0x8000 << COLUMN_BITS));
+
+    for (int x = 0; x < width; ++x) {
+        unsigned short const* w = &weights[taps[x].weights];
+        unsigned short const* src = acc + taps[x].first * channels;
+
+        __m128i sum = round;
+        for (int i = 0; i < count; i += 2) {
+            int pair;
+            memcpy (&pair, w + i, sizeof (pair));
+
+            __m128i a = _mm_loadl_epi64 ((const __m128i*) src);
+            __m128i b = _mm_loadl_epi64 ((const __m128i*) (src + channels));
+            __m128i p = _mm_unpacklo_epi16 (a, b);
+            p = _mm_madd_epi16 (_mm_xor_si128 (p, bias), _mm_set1_epi32 (pair));
+
+            sum = _mm_add_epi32 (sum, p);
+            src += 2 * channels;
+        }
+
+        sum = _mm_srli_epi32 (sum, TOTAL_BITS);
+        sum = _mm_packs_epi32 (sum, sum);
+        sum = _mm_packus_epi16 (sum, sum);
+
+        int pixel = _mm_cvtsi128_si32 (sum);
+        memcpy (dst, &pixel, channels);
+        dst += channels;
+    }
+}
+#elif defined(AREA_DOWNSCALE_NEON)
+/*
+ * Averages the intermediate row of a 3 or 4 channel image, all the channels
+ * of a pixel are processed at once
+ */
+template <int channels>
+static void average_row_simd (unsigned char* dst,
+                              unsigned short const* acc,
+                              const int width,
+                              const int count,
+                              const std::vector<Taps>& taps,
+                              const std::vector<unsigned short>& weights)
+{
+    const uint32x4_t round = vdupq_n_u32 (1 << (TOTAL_BITS - 1));
+
+    for (int x = 0; x < width; ++x) {
+        unsigned short const* w = &weights[taps[x].weights];
+        unsigned short const* src = acc + taps[x].first * channels;
+
+        uint32x4_t sum = round;
+        for (int i = 0; i < count; ++i) {
+            sum = vmlal_n_u16 (sum, vld1_u16 (src), w[i]);
+            src += channels;
+        }
+
+        uint16x4_t narrow = vmovn_u32 (vshrq_n_u32 (sum, TOTAL_BITS));
+        uint8x8_t pixel = vmovn_u16 (vcombine_u16 (narrow, narrow));
+
+        unsigned char bytes[8];
+        vst1_u8 (bytes, pixel);
+        memcpy (dst, bytes, channels);
+        dst += channels;
+    }
+}
+#endif
+
+/*
+ * Adds \a count source rows and stores the sums in the intermediate row, this
+ * is the vertical pass used for 2:1 and 4:1 ratios. The sums of up to four
+ * rows fit in 16-bit integers
+ */
+static void sum_rows_c (unsigned short* acc,
+                        unsigned char const* row,
+                        const int stride,
+                        const int count,
+                        const int length)
+{
+    for (int i = 0; i < length; ++i) {
+        unsigned int sum = 0;
+        for (int j = 0; j < count; ++j)
+            sum += row[j * stride + i];
+
+        acc[i] = (unsigned short) sum;
+    }
+}
+
+#if defined(AREA_DOWNSCALE_SSE2)
+static void sum_rows_simd (unsigned short* acc,
+                           unsigned char const* row,
+                           const int stride,
+                           const int count,
+                           const int length)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i lo = zero;
+        __m128i hi = zero;
+        for (int j = 0; j < count; ++j) {
+            __m128i pixels = _mm_loadu_si128 ((const __m128i*) (row + j * stride + i));
+            lo = _mm_add_epi16 (lo, _mm_unpacklo_epi8 (pixels, zero));
+            hi = _mm_add_epi16 (hi, _mm_unpackhi_epi8 (pixels, zero));
+        }
+
+        _mm_storeu_si128 ((__m128i*) (acc + i), lo);
+        _mm_storeu_si128 ((__m128i*) (acc + i + 8), hi);
+    }
+
+    sum_rows_c (acc + i, row + i, stride, count, length - i);
+}
+#elif defined(AREA_DOWNSCALE_NEON)
+static void sum_rows_simd (unsigned short* acc,
+                           unsigned char const* row,
+                           const int stride,
+                           const int count,
+                           const int length)
+{
+    int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t pixels = vld1q_u8 (row + i);
+        uint16x8_t lo = vmovl_u8 (vget_low_u8 (pixels));
+        uint16x8_t hi = vmovl_u8 (vget_high_u8 (pixels));
+
+        for (int j = 1; j < count; ++j) {
+            pixels = vld1q_u8 (row + j * stride + i);
+            lo = vaddw_u8 (lo, vget_low_u8 (pixels));
+            hi = vaddw_u8 (hi, vget_high_u8 (pixels));
+        }
+
+        vst1q_u16 (acc + i, lo);
+        vst1q_u16 (acc + i + 8, hi);
+    }
+
+    sum_rows_c (acc + i, row + i, stride, count, length - i);
+}
+#endif
+
+/*
+ * Averages the intermediate row when every destination pixel covers exactly
+ * 2^bits x 2^bits source pixels. The intermediate values are plain sums of
+ * the source rows, so no weights are needed and the division is a shift
+ */
+template <int bits>
+static void box_row_c (unsigned char* dst,
+                       unsigned short const* acc,
+                       const int width,
+                       const int channels)
+{
+    const unsigned int round = 1 << (2 * bits - 1);
+
+    for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < channels; ++c) {
+            unsigned int sum = round;
+            for (int i = 0; i < (1 << bits); ++i)
+                sum += acc[i * channels + c];
+
+            *dst++ = (unsigned char) (sum >> (2 * bits));
+        }
+
+        acc += channels << bits;
+    }
+}
+
+/*
+ * Box averages a 4 channel image directly from the source rows
+ */
+template <int bits>
+static void box_rgba_c (unsigned char* dst,
+                        unsigned char const* row,
+                        const int stride,
+                        const int width)
+{
+    const unsigned int round = 1 << (2 * bits - 1);
+
+    for (int x = 0; x < width; ++x) {
+        for (int c = 0; c < 4; ++c) {
+            unsigned int sum = round;
+            for (int j = 0; j < (1 << bits); ++j)
+                for (int i = 0; i < (1 << bits); ++i)
+                    sum += row[j * stride + i * 4 + c];
+
+            *dst++ = (unsigned char) (sum >> (2 * bits));
+        }
+
+        row += 4 << bits;
+    }
+}
+
+#if defined(AREA_DOWNSCALE_SSE2)
+/*
+ * Box averages a single channel row, 8 destination pixels at a time. The
+ * neighbouring values are added with madd instructions (the sums are small
+ * enough to fit in signed 16-bit integers)
+ */
+template <int bits>
+static void box_row_gray_simd (unsigned char* dst,
+                               unsigned short const* acc,
+                               const int width)
+{
+    const __m128i ones = _mm_set1_epi16 (1);
+    const __m128i round = _mm_set1_epi16 (1 << (2 * bits - 1));
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) acc);
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (acc + 8));
+        __m128i sum = _mm_packs_epi32 (_mm_madd_epi16 (a, ones),
+                                       _mm_madd_epi16 (b, ones));
+
+        if (bits == 2) {
+            __m128i c = _mm_loadu_si128 ((const __m128i*) (acc + 16));
+            __m128i d = _mm_loadu_si128 ((const __m128i*) (acc + 24));
+            __m128i hi = _mm_packs_epi32 (_mm_madd_epi16 (c, ones),
+                                          _mm_madd_epi16 (d, ones));
+            sum = _mm_packs_epi32 (_mm_madd_epi16 (sum, ones),
+                                   _mm_madd_epi16 (hi, ones));
+        }
+
+        sum = _mm_srli_epi16 (_mm_add_epi16 (sum, round), 2 * bits);
+        _mm_storel_epi64 ((__m128i*) (dst + x), _mm_packus_epi16 (sum, sum));
+        acc += 8 << bits;
+    }
+
+    box_row_c<bits> (dst + x, acc, width - x, 1);
+}
+
+/*
+ * Box averages the row of a 3 channel image, all the channels of a pixel are
+ * processed at once. Pixels are written with 4-byte stores, the extra byte
+ * is overwritten by the next pixel
+ */
+template <int bits>
+static void box_row_rgb_simd (unsigned char* dst,
+                              unsigned short const* acc,
+                              const int width)
+{
+    const __m128i round = _mm_set1_epi16 (1 << (2 * bits - 1));
+
+    for (int x = 0; x < width; ++x) {
+        __m128i sum = round;
+        for (int i = 0; i < (1 << bits); ++i)
+            sum = _mm_add_epi16 (sum, _mm_loadl_epi64 ((const __m128i*) (acc + i * 3)));
+
+        sum = _mm_srli_epi16 (sum, 2 * bits);
+        sum = _mm_packus_epi16 (sum, sum);
+
+        int pixel = _mm_cvtsi128_si32 (sum);
+        memcpy (dst, &pixel, x + 1 < width ? 4 : 3);
+        dst += 3;
+        acc += 3 << bits;
+    }
+}
+
+/*
+ * Box averages a 4 channel image directly from the source rows, without an
+ * intermediate row. Every iteration writes two destination pixels, which
+ * are obtained by adding the halves of the registers
+ */
+template <int bits>
+static void box_rgba_simd (unsigned char* dst,
+                           unsigned char const* row,
+                           const int stride,
+                           const int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16 (1 << (2 * bits - 1));
+
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        __m128i a = zero;
+        __m128i b = zero;
+        for (int j = 0; j < (1 << bits); ++j) {
+            unsigned char const* p = row + j * stride + (x << bits) * 4;
+            __m128i c = _mm_loadu_si128 ((const __m128i*) p);
+
+            if (bits == 1) {
+                a = _mm_add_epi16 (a, _mm_unpacklo_epi8 (c, zero));
+                b = _mm_add_epi16 (b, _mm_unpackhi_epi8 (c, zero));
+            }
+
+            else {
+                __m128i d = _mm_loadu_si128 ((const __m128i*) (p + 16));
+                a = _mm_add_epi16 (a, _mm_add_epi16 (_mm_unpacklo_epi8 (c, zero),
+                                                     _mm_unpackhi_epi8 (c, zero)));
+                b = _mm_add_epi16 (b, _mm_add_epi16 (_mm_unpacklo_epi8 (d, zero),
+                                                     _mm_unpackhi_epi8 (d, zero)));
+            }
+        }
+
+        __m128i sum = _mm_add_epi16 (_mm_unpacklo_epi64 (a, b),
+                                     _mm_unpackhi_epi64 (a, b));
+        sum = _mm_srli_epi16 (_mm_add_epi16 (sum, round), 2 * bits);
+        _mm_storel_epi64 ((__m128i*) (dst + x * 4), _mm_packus_epi16 (sum, sum));
+    }
+
+    box_rgba_c<bits> (dst + x * 4, row + (x << bits) * 4, stride, width - x);
+}
+#elif defined(AREA_DOWNSCALE_NEON)
+/*
+ * Box averages a single channel row, 8 destination pixels at a time. The
+ * structure loads split the neighbouring values into separate registers
+ */
+template <int bits>
+static void box_row_gray_simd (unsigned char* dst,
+                               unsigned short const* acc,
+                               const int width)
+{
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t sum;
+        if (bits == 1) {
+            uint16x8x2_t v = vld2q_u16 (acc);
+            sum = vaddq_u16 (v.val[0], v.val[1]);
+        }
+
+        else {
+            uint16x8x4_t v = vld4q_u16 (acc);
+            sum = vaddq_u16 (vaddq_u16 (v.val[0], v.val[1]),
+                             vaddq_u16 (v.val[2], v.val[3]));
+        }
+
+        vst1_u8 (dst + x, vmovn_u16 (vrshrq_n_u16 (sum, 2 * bits)));
+        acc += 8 << bits;
+    }
+
+    box_row_c<bits> (dst + x, acc, width - x, 1);
+}
+
+/*
+ * Box averages the row of a 3 channel image, all the channels of a pixel are
+ * processed at once
+ */
+template <int bits>
+static void box_row_rgb_simd (unsigned char* dst,
+                              unsigned short const* acc,
+                              const int width)
+{
+    for (int x = 0; x < width; ++x) {
+        uint16x4_t sum = vld1_u16 (acc);
+        for (int i = 1; i < (1 << bits); ++i)
+            sum = vadd_u16 (sum, vld1_u16 (acc + i * 3));
+
+        uint16x8_t wide = vrshrq_n_u16 (vcombine_u16 (sum, sum), 2 * bits);
+
+        unsigned char bytes[8];
+        vst1_u8 (bytes, vmovn_u16 (wide));
+        memcpy (dst, bytes, 3);
+        dst += 3;
+        acc += 3 << bits;
+    }
+}
+
+/*
+ * Box averages a 4 channel image directly from the source rows, without an
+ * intermediate row. Every iteration writes two destination pixels, which
+ * are obtained by adding the halves of the registers
+ */
+template <int bits>
+static void box_rgba_simd (unsigned char* dst,
+                           unsigned char const* row,
+                           const int stride,
+                           const int width)
+{
+    int x = 0;
+    for (; x + 2 <= width; x += 2) {
+        uint16x8_t a = vdupq_n_u16 (0);
+        uint16x8_t b = vdupq_n_u16 (0);
+        for (int j = 0; j < (1 << bits); ++j) {
+            unsigned char const* p = row + j * stride + (x << bits) * 4;
+            uint8x16_t c = vld1q_u8 (p);
+
+            if (bits == 1) {
+                a = vaddw_u8 (a, vget_low_u8 (c));
+                b = vaddw_u8 (b, vget_high_u8 (c));
+            }
+
+            else {
+                uint8x16_t d = vld1q_u8 (p + 16);
+                a = vaddw_u8 (vaddw_u8 (a, vget_low_u8 (c)), vget_high_u8 (c));
+                b = vaddw_u8 (vaddw_u8 (b, vget_low_u8 (d)), vget_high_u8 (d));
+            }
+        }
+
+        uint16x8_t sum = vaddq_u16 (vcombine_u16 (vget_low_u16 (a), vget_low_u16 (b)),
+                                    vcombine_u16 (vget_high_u16 (a), vget_high_u16 (b)));
+        vst1_u8 (dst + x * 4, vmovn_u16 (vrshrq_n_u16 (sum, 2 * bits)));
+    }
+
+    box_rgba_c<bits> (dst + x * 4, row + (x << bits) * 4, stride, width - x);
+}
+#endif
+
+/*
+ * Downscales the image when both ratios are 2^bits. Most rungs of the stream
+ * ladder are exact 2:1 or 4:1 reductions (e.g. 1280x960 to 640x480 and
+ * 320x240), which only need the sum of every block of pixels
+ */
+template <int bits>
+static void box_downscale (unsigned char* dst,
+                           const int dst_width,
+                           const int dst_height,
+                           const int dst_stride,
+                           unsigned char const* src,
+                           const int src_width,
+                           const int src_stride,
+                           const int channels)
+{
+    /* Intermediate row, padded for the 64-bit loads of 3 channel pixels */
+    const int length = src_width * channels;
+    std::vector<unsigned short> acc (length + channels, 0);
+
+    for (int y = 0; y < dst_height; ++y) {
+        unsigned char const* row = src + (y << bits) * src_stride;
+        unsigned char* line = dst + y * dst_stride;
+
+        /* Add the source rows, then average the columns */
+#if defined(AREA_DOWNSCALE_SSE2) || defined(AREA_DOWNSCALE_NEON)
+        if (channels == 4) {
+            box_rgba_simd<bits> (line, row, src_stride, dst_width);
+            continue;
+        }
+
+        sum_rows_simd (&acc[0], row, src_stride, 1 << bits, length);
+        if (channels == 1)
+            box_row_gray_simd<bits> (line, &acc[0], dst_width);
+        else
+            box_row_rgb_simd<bits> (line, &acc[0], dst_width);
+#else
+        sum_rows_c (&acc[0], row, src_stride, 1 << bits, length);
+        box_row_c<bits> (line, &acc[0], dst_width, channels);
+#endif
+    }
+}
+
+bool area_downscale (unsigned char* dst,
+                     const int dst_width,
+                     const int dst_height,
+                     const int dst_stride,
+                     unsigned char const* src,
+                     const int src_width,
+                     const int src_height,
+                     const int src_stride,
+                     const int channels)
+{
+    static const AccumulateFunc accumulate = select_accumulate();
+
+    /* Check parameters */
+    if (!dst || !src || dst_width <= 0 || dst_height <= 0)
+        return false;
+    if (dst_width > src_width || dst_height > src_height)
+        return false;
+    if (channels != 1 && channels != 3 && channels != 4)
+        return false;
+
+    /* Use the box filter for exact 2:1 and 4:1 ratios */
+    if (src_width == dst_width * 2 && src_height == dst_height * 2) {
+        box_downscale<1> (dst, dst_width, dst_height, dst_stride,
+                          src, src_width, src_stride, channels);
+        return true;
+    }
+
+    if (src_width == dst_width * 4 && src_height == dst_height * 4) {
+        box_downscale<2> (dst, dst_width, dst_height, dst_stride,
+                          src, src_width, src_stride, channels);
+        return true;
+    }
+
+    /* Calculate the filter weights */
+    std::vector<Taps> rows;
+    std::vector<Taps> columns;
+    std::vector<unsigned short> row_weights;
+    std::vector<unsigned short> column_weights;
+    compute_taps (src_height, dst_height, ROW_BITS, false, rows, row_weights);
+    int count = compute_taps (src_width, dst_width, COLUMN_BITS, true,
+                              columns, column_weights);
+
+    /* Intermediate (vertically averaged) row, padded for the unused taps */
+    const int length = src_width * channels;
+    std::vector<unsigned short> acc (length + (count + 1) * channels, 0);
+
+    for (int y = 0; y < dst_height; ++y) {
+        const Taps& tap = rows[y];
+
+        /* Average the source rows */
+        for (int i = 0; i < tap.count; ++i)
+            accumulate (&acc[0],
+                        src + (tap.first + i) * src_stride,
+                        length,
+                        row_weights[tap.weights + i],
+                        i == 0);
+
+        /* Average the columns and write the destination row */
+        unsigned char* line = dst + y * dst_stride;
+#if defined(AREA_DOWNSCALE_SSE2) || defined(AREA_DOWNSCALE_NEON)
+        if (channels == 3)
+            average_row_simd<3> (line, &acc[0], dst_width, count, columns, column_weights);
+        else if (channels == 4)
+            average_row_simd<4> (line, &acc[0], dst_width, count, columns, column_weights);
+        else
+#endif
+            average_row_c (line, &acc[0], dst_width, channels, count, columns, column_weights);
+    }
+
+    return true;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef AREA_DOWNSCALE_H
+#define AREA_DOWNSCALE_H
+
+/*
+ * Downscales an 8-bit image with 1, 3 or 4 interleaved channels using an
+ * area-averaging (box) filter. Integer and fractional ratios are supported,
+ * each destination pixel is the weighted average of the source pixels that
+ * it covers. Exact 2:1 and 4:1 ratios use faster kernels that only add and
+ * shift, and their results are rounded exactly.
+ *
+ * Returns false if the destination is larger than the source in any
+ * direction or if the parameters are invalid.
+ */
+bool area_downscale (unsigned char* dst,
+                     const int dst_width,
+                     const int dst_height,
+                     const int dst_stride,
+                     unsigned char const* src,
+                     const int src_width,
+                     const int src_height,
+                     const int src_stride,
+                     const int channels);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include "nv12_transform.h"
+
+#include <vector>
+#include <cstddef>
+
+/*
+ * Converts a BT.601 (video range) YUV pixel to RGB, using the same
+ * coefficients as the yuv2rgb library
+ */
+static inline unsigned char clamp (const int value)
+{
+    return (unsigned char) (value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+struct Chroma {
+    int r;
+    int g;
+    int b;
+};
+
+static inline Chroma chroma_terms (const int u, const int v)
+{
+    Chroma chroma;
+    chroma.r = 409 * (v - 128);
+    chroma.g = -100 * (u - 128) - 208 * (v - 128);
+    chroma.b = 516 * (u - 128);
+    return chroma;
+}
+
+static inline void write_pixel (unsigned char* rgb, int y, const Chroma& c)
+{
+    y = 298 * (y > 16 ? y - 16 : 0) + 128;
+
+    rgb[0] = clamp ((y + c.r) >> 8);
+    rgb[1] = clamp ((y + c.g) >> 8);
+    rgb[2] = clamp ((y + c.b) >> 8);
+}
+
+/*
+ * Divides the given \a sum by the number of samples, using the reciprocal
+ * of the number of samples (in 16.16 fixed point)
+ */
+static inline int average (const unsigned int sum, const unsigned int recip)
+{
+    return (int) ((sum * recip + 0x8000) >> 16);
+}
+
+bool nv12_transform_to_rgb (unsigned char* rgb,
+                            const int rgb_stride,
+                            unsigned char const* y,
+                            const int y_stride,
+                            unsigned char const* uv,
+                            const int uv_stride,
+                            const int width,
+                            const int height,
+                            const int factor,
+                            const int rotation,
+                            const bool flip,
+                            const bool nv21)
+{
+    /* Check parameters */
+    if (!rgb || !y || !uv || factor < 1 || rotation % 90 != 0)
+        return false;
+    if (width < factor || height < factor)
+        return false;
+
+    /* Get output size (before and after rotation) */
+    const int k = factor;
+    const int cols = width / k;
+    const int rows = height / k;
+    const int turn = ((rotation % 360) + 360) % 360;
+    const int out_height = (turn == 90 || turn == 270) ? cols : rows;
+
+    /* Position of the U and V samples in the chroma plane */
+    const int u_offset = nv21 ? 1 : 0;
+    const int v_offset = nv21 ? 0 : 1;
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+
+    /* Reciprocals of the number of samples in a box */
+    const unsigned int y_recip = 65536 / (k * k);
+    std::vector<unsigned int> c_recips ((k + 1) * (k + 1) + 1, 0);
+    for (int i = 1; i < (int) c_recips.size(); ++i)
+        c_recips[i] = 65536 / i;
+
+    /* Column sums of the current box row */
+    std::vector<unsigned int> y_sum (cols * k);
+    std::vector<unsigned int> u_sum (chroma_width);
+    std::vector<unsigned int> v_sum (chroma_width);
+
+    for (int by = 0; by < rows; ++by) {
+        /* Position of the first pixel of the row and distance between pixels */
+        int x0 = 0, y0 = 0, dx = 0, dy = 0;
+        switch (turn) {
+        case 0:
+            x0 = 0, y0 = by, dx = 1;
+            break;
+        case 90:
+            x0 = rows - 1 - by, y0 = 0, dy = 1;
+            break;
+        case 180:
+            x0 = cols - 1, y0 = rows - 1 - by, dx = -1;
+            break;
+        default:
+            x0 = by, y0 = cols - 1, dy = -1;
+            break;
+        }
+
+        if (flip) {
+            y0 = out_height - 1 - y0;
+            dy = -dy;
+        }
+
+        unsigned char* out = rgb + (ptrdiff_t) y0 * rgb_stride + x0 * 3;
+        const ptrdiff_t step = (ptrdiff_t) dy * rgb_stride + dx * 3;
+
+        /* Chroma rows covered by this box row */
+        const int c_first = (by * k) / 2;
+        const int c_last = (by * k + k - 1) / 2 < chroma_height ?
+                           (by * k + k - 1) / 2 : chroma_height - 1;
+
+        /* Fast path, no downscaling (each chroma sample is used twice) */
+        if (k == 1) {
+            unsigned char const* luma = y + (ptrdiff_t) by * y_stride;
+            unsigned char const* chroma = uv + (ptrdiff_t) c_first * uv_stride;
+
+            for (int bx = 0; bx < cols; bx += 2, chroma += 2) {
+                Chroma c = chroma_terms (chroma[u_offset], chroma[v_offset]);
+                write_pixel (out, luma[bx], c);
+                out += step;
+
+                if (bx + 1 < cols) {
+                    write_pixel (out, luma[bx + 1], c);
+                    out += step;
+                }
+            }
+
+            continue;
+        }
+
+        /* Add the luma rows of the box row */
+        for (int i = 0; i < cols * k; ++i)
+            y_sum[i] = 0;
+
+        for (int r = 0; r < k; ++r) {
+            unsigned char const* luma = y + (ptrdiff_t) (by * k + r) * y_stride;
+            for (int i = 0; i < cols * k; ++i)
+                y_sum[i] += luma[i];
+        }
+
+        /* Add the chroma rows of the box row */
+        for (int i = 0; i < chroma_width; ++i)
+            u_sum[i] = v_sum[i] = 0;
+
+        for (int r = c_first; r <= c_last; ++r) {
+            unsigned char const* chroma = uv + (ptrdiff_t) r * uv_stride;
+            for (int i = 0; i < chroma_width; ++i) {
+                u_sum[i] += chroma[i * 2 + u_offset];
+                v_sum[i] += chroma[i * 2 + v_offset];
+            }
+        }
+
+        /* Average each box and write the pixel */
+        const unsigned int c_rows = c_last - c_first + 1;
+        for (int bx = 0; bx < cols; ++bx, out += step) {
+            unsigned int ys = 0;
+            for (int i = bx * k; i < bx * k + k; ++i)
+                ys += y_sum[i];
+
+            unsigned int us = 0;
+            unsigned int vs = 0;
+            const int first = (bx * k) / 2;
+            const int last = (bx * k + k - 1) / 2;
+            for (int i = first; i <= last; ++i) {
+                us += u_sum[i];
+                vs += v_sum[i];
+            }
+
+            const unsigned int c_recip = c_recips[(last - first + 1) * c_rows];
+            write_pixel (out,
+                         average (ys, y_recip),
+                         chroma_terms (average (us, c_recip),
+                                       average (vs, c_recip)));
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Downscales a single plane by the integer factor \a k and writes it with
+ * the given rotation and flip. Samples of the source plane are \a step bytes
+ * apart (interleaved chroma samples are two bytes apart). The output is
+ * \a cols x \a rows pixels before the rotation
+ */
+static void transform_plane (unsigned char* dst,
+                             const int dst_stride,
+                             unsigned char const* src,
+                             const int src_stride,
+                             const int step,
+                             const int cols,
+                             const int rows,
+                             const int k,
+                             const int turn,
+                             const bool flip)
+{
+    const int out_height = (turn == 90 || turn == 270) ? cols : rows;
+    const unsigned int recip = 65536 / (k * k);
+    std::vector<unsigned int> sum (cols * k);
+
+    for (int by = 0; by < rows; ++by) {
+        /* Position of the first pixel of the row and distance between pixels */
+        int x0 = 0, y0 = 0, dx = 0, dy = 0;
+        switch (turn) {
+        case 0:
+            x0 = 0, y0 = by, dx = 1;
+            break;
+        case 90:
+            x0 = rows - 1 - by, y0 = 0, dy = 1;
+            break;
+        case 180:
+            x0 = cols - 1, y0 = rows - 1 - by, dx = -1;
+            break;
+        default:
+            x0 = by, y0 = cols - 1, dy = -1;
+            break;
+        }
+
+        if (flip) {
+            y0 = out_height - 1 - y0;
+            dy = -dy;
+        }
+
+        unsigned char* out = dst + (ptrdiff_t) y0 * dst_stride + x0;
+        const ptrdiff_t out_step = (ptrdiff_t) dy * dst_stride + dx;
+
+        /* Copy the samples */
+        if (k == 1) {
+            unsigned char const* line = src + (ptrdiff_t) by * src_stride;
+            for (int bx = 0; bx < cols; ++bx, out += out_step)
+                *out = line[bx * step];
+
+            continue;
+        }
+
+        /* Add the rows of the box */
+        for (int i = 0; i < cols * k; ++i)
+            sum[i] = 0;
+
+        for (int r = 0; r < k; ++r) {
+            unsigned char const* line = src + (ptrdiff_t) (by * k + r) * src_stride;
+            for (int i = 0; i < cols * k; ++i)
+                sum[i] += line[i * step];
+        }
+
+        /* Average the boxes */
+        for (int bx = 0; bx < cols; ++bx, out += out_step) {
+            unsigned int total = 0;
+            for (int i = bx * k; i < bx * k + k; ++i)
+                total += sum[i];
+
+            *out = (unsigned char) average (total, recip);
+        }
+    }
+}
+
+bool nv12_transform_to_i420 (unsigned char* y_out,
+                             const int y_out_stride,
+                             unsigned char* u_out,
+                             const int u_out_stride,
+                             unsigned char* v_out,
+                             const int v_out_stride,
+                             unsigned char const* y,
+                             const int y_stride,
+                             unsigned char const* uv,
+                             const int uv_stride,
+                             const int width,
+                             const int height,
+                             const int factor,
+                             const int rotation,
+                             const bool flip,
+                             const bool nv21)
+{
+    /* Check parameters */
+    if (!y_out || !u_out || !v_out || !y || !uv)
+        return false;
+    if (factor < 1 || rotation % 90 != 0)
+        return false;
+
+    /* Get output size (before the rotation), rounded to even numbers */
+    const int cols = (width / factor) & ~1;
+    const int rows = (height / factor) & ~1;
+    const int turn = ((rotation % 360) + 360) % 360;
+    if (cols < 2 || rows < 2)
+        return false;
+
+    /* Transform the luma plane */
+    transform_plane (y_out, y_out_stride, y, y_stride, 1,
+                     cols, rows, factor, turn, flip);
+
+    /* Transform the chroma planes */
+    transform_plane (u_out, u_out_stride, uv + (nv21 ? 1 : 0), uv_stride, 2,
+                     cols / 2, rows / 2, factor, turn, flip);
+    transform_plane (v_out, v_out_stride, uv + (nv21 ? 0 : 1), uv_stride, 2,
+                     cols / 2, rows / 2, factor, turn, flip);
+
+    return true;
+}
+
+bool i420_to_rgb (unsigned char* rgb,
+                  const int rgb_stride,
+                  unsigned char const* y,
+                  const int y_stride,
+                  unsigned char const* u,
+                  const int u_stride,
+                  unsigned char const* v,
+                  const int v_stride,
+                  const int width,
+                  const int height)
+{
+    if (!rgb || !y || !u || !v || width % 2 != 0 || height % 2 != 0)
+        return false;
+
+    for (int row = 0; row < height; ++row) {
+        unsigned char* out = rgb + (ptrdiff_t) row * rgb_stride;
+        unsigned char const* luma = y + (ptrdiff_t) row * y_stride;
+        unsigned char const* cb = u + (ptrdiff_t) (row / 2) * u_stride;
+        unsigned char const* cr = v + (ptrdiff_t) (row / 2) * v_stride;
+
+        for (int x = 0; x < width; x += 2, out += 6) {
+            Chroma c = chroma_terms (cb[x / 2], cr[x / 2]);
+            write_pixel (out, luma[x], c);
+            write_pixel (out + 3, luma[x + 1], c);
+        }
+    }
+
+    return true;
+}
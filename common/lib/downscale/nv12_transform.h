@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef NV12_TRANSFORM_H
+#define NV12_TRANSFORM_H
+
+/*
+ * Converts an NV12 (or NV21) image to RGB888 in a single pass. The image is
+ * downscaled by the integer \a factor (each output pixel is the average of
+ * a factor x factor box), rotated clockwise by \a rotation degrees (0, 90,
+ * 180 or 270) and optionally flipped vertically (after the rotation).
+ *
+ * The output image must be (width / factor) x (height / factor) pixels, with
+ * the width and height swapped if the image is rotated by 90 or 270 degrees.
+ *
+ * Returns false if the parameters are invalid.
+ */
+bool nv12_transform_to_rgb (unsigned char* rgb,
+                            const int rgb_stride,
+                            unsigned char const* y,
+                            const int y_stride,
+                            unsigned char const* uv,
+                            const int uv_stride,
+                            const int width,
+                            const int height,
+                            const int factor,
+                            const int rotation,
+                            const bool flip,
+                            const bool nv21);
+
+/*
+ * Converts an NV12 (or NV21) image to planar I420 (YUV 4:2:0), while
+ * downscaling, rotating and flipping it like nv12_transform_to_rgb.
+ *
+ * The output size is calculated as in nv12_transform_to_rgb, and then
+ * rounded down to an even number of pixels. The chroma planes are half the
+ * width and height of the luma plane.
+ *
+ * Returns false if the parameters are invalid.
+ */
+bool nv12_transform_to_i420 (unsigned char* y_out,
+                             const int y_out_stride,
+                             unsigned char* u_out,
+                             const int u_out_stride,
+                             unsigned char* v_out,
+                             const int v_out_stride,
+                             unsigned char const* y,
+                             const int y_stride,
+                             unsigned char const* uv,
+                             const int uv_stride,
+                             const int width,
+                             const int height,
+                             const int factor,
+                             const int rotation,
+                             const bool flip,
+                             const bool nv21);
+
+/*
+ * Converts a planar I420 image with even dimensions to RGB888
+ */
+bool i420_to_rgb (unsigned char* rgb,
+                  const int rgb_stride,
+                  unsigned char const* y,
+                  const int y_stride,
+                  unsigned char const* u,
+                  const int u_stride,
+                  unsigned char const* v,
+                  const int v_stride,
+                  const int width,
+                  const int height);
+
+#endif
@@ -33,26 +33,65 @@ QMAKE_CXXFLAGS_RELEASE -= -O2
 QMAKE_CXXFLAGS_RELEASE *= -O3
 
 include ($$PWD/lib/yuv2rgb/yuv2rgb.pri)
+include ($$PWD/lib/downscale/downscale.pri)
+
+#
+# Optional LZ4 support (for uncompressed image payloads), build with
+# qmake CONFIG+=lz4 to enable it
+#
+lz4 {
+    LIBS += -llz4
+    DEFINES += QCCTV_ENABLE_LZ4
+}
+
+#
+# Optional TurboJPEG support (to compress YUV camera frames without
+# converting them to RGB), build with qmake CONFIG+=turbojpeg to enable it
+#
+turbojpeg {
+    LIBS += -lturbojpeg
+    DEFINES += QCCTV_ENABLE_TURBOJPEG
+}
+
+#
+# Optional xxHash support (to validate frames with XXH3 when both peers
+# support it), build with qmake CONFIG+=xxhash to enable it
+#
+xxhash {
+    LIBS += -lxxhash
+    DEFINES += QCCTV_ENABLE_XXHASH
+}
 
 HEADERS += \
+    $$PWD/src/QCCTV_Checksum.h \
     $$PWD/src/QCCTV_Communications.h \
     $$PWD/src/QCCTV_CRC32.h \
+    $$PWD/src/QCCTV_DeltaEncoder.h \
     $$PWD/src/QCCTV_Discovery.h \
+    $$PWD/src/QCCTV_FrameEncoder.h \
+    $$PWD/src/QCCTV_FrameQueue.h \
     $$PWD/src/QCCTV_ImageCapture.h \
     $$PWD/src/QCCTV_ImageSaver.h \
     $$PWD/src/QCCTV_LocalCamera.h \
+    $$PWD/src/QCCTV_RateController.h \
+    $$PWD/src/QCCTV_ReceiveBuffer.h \
     $$PWD/src/QCCTV_RemoteCamera.h \
     $$PWD/src/QCCTV_Station.h \
     $$PWD/src/QCCTV_Watchdog.h \
     $$PWD/src/QCCTV.h
 
 SOURCES += \
+    $$PWD/src/QCCTV_Checksum.cpp \
     $$PWD/src/QCCTV_Communications.cpp \
     $$PWD/src/QCCTV_CRC32.cpp \
+    $$PWD/src/QCCTV_DeltaEncoder.cpp \
     $$PWD/src/QCCTV_Discovery.cpp \
+    $$PWD/src/QCCTV_FrameEncoder.cpp \
     $$PWD/src/QCCTV_ImageCapture.cpp \
     $$PWD/src/QCCTV_ImageSaver.cpp \
     $$PWD/src/QCCTV_LocalCamera.cpp \
+    $$PWD/src/QCCTV_RateController.cpp \
+    $$PWD/src/QCCTV_ReceiveBuffer.cpp \
     $$PWD/src/QCCTV_RemoteCamera.cpp \
     $$PWD/src/QCCTV_Station.cpp \
     $$PWD/src/QCCTV_Watchdog.cpp \
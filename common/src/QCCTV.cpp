@@ -21,12 +21,46 @@
  */
 
 #include "QCCTV.h"
+#include "downscale.h"
+#include "nv12_transform.h"
 
 #include <QBuffer>
 #include <QObject>
 #include <QPixmap>
 #include <QPainter>
+#include <QtEndian>
 #include <QFontMetrics>
+#include <QElapsedTimer>
+
+#ifdef QCCTV_ENABLE_LZ4
+    #include <lz4.h>
+#endif
+
+#ifdef QCCTV_ENABLE_TURBOJPEG
+    #include <QThreadStorage>
+    #include <turbojpeg.h>
+
+/**
+ * Keeps a TurboJPEG compressor and its output buffer, so that they can be
+ * re-used by each thread that encodes images
+ */
+class QCCTV_JpegCompressor
+{
+public:
+    QCCTV_JpegCompressor() : handle (tjInitCompress()), buffer (NULL), size (0) {}
+    ~QCCTV_JpegCompressor()
+    {
+        tjFree (buffer);
+        tjDestroy (handle);
+    }
+
+    tjhandle handle;
+    unsigned char* buffer;
+    unsigned long size;
+};
+
+static QThreadStorage<QCCTV_JpegCompressor*> COMPRESSORS;
+#endif
 
 /**
  * If a is not empty, the function appends \a b to \a a and adds a separator.
@@ -41,6 +75,16 @@ static QString append_str (const QString a, QString b)
         return a + " | " + b;
 }
 
+/**
+ * Returns a started timer, used as the reference of \c QCCTV_Timestamp()
+ */
+static QElapsedTimer start_timer()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
 /**
  * Returns a valid FPS value
  */
@@ -49,6 +93,50 @@ int QCCTV_ValidFps (const int fps)
     return qMax (qMin (fps, QCCTV_MAX_FPS), QCCTV_MIN_FPS);
 }
 
+/**
+ * Returns a bitmask with the image payload codecs that this build of QCCTV
+ * is able to encode and decode. Each codec is represented by the bit
+ * (1 << codec), where \a codec is a value of \c QCCTV_Codec
+ */
+int QCCTV_SupportedCodecs()
+{
+    int codecs = (1 << QCCTV_CODEC_ZLIB) | (1 << QCCTV_CODEC_JPEG);
+
+#ifdef QCCTV_ENABLE_LZ4
+    codecs |= (1 << QCCTV_CODEC_LZ4);
+#endif
+
+    return codecs;
+}
+
+/**
+ * Returns a bitmask with the frame integrity algorithms that this build of
+ * QCCTV is able to compute. Each algorithm is represented by the bit
+ * (1 << algorithm), where \a algorithm is a value of
+ * \c QCCTV_ChecksumAlgorithm
+ */
+int QCCTV_SupportedChecksums()
+{
+    int algorithms = (1 << QCCTV_CHECKSUM_CRC32) | (1 << QCCTV_CHECKSUM_CRC32C);
+
+#ifdef QCCTV_ENABLE_XXHASH
+    algorithms |= (1 << QCCTV_CHECKSUM_XXHASH);
+#endif
+
+    return algorithms;
+}
+
+/**
+ * Returns the number of microseconds elapsed since the first call to this
+ * function. All the pipeline stages use this monotonic clock to timestamp
+ * frames, so that their values can be compared between threads
+ */
+qint64 QCCTV_Timestamp()
+{
+    static const QElapsedTimer timer = start_timer();
+    return timer.nsecsElapsed() / 1000;
+}
+
 /**
  * Returns a valid watchdog timeout value
  */
@@ -143,30 +231,325 @@ QSize QCCTV_GetResolution (const int resolution)
 }
 
 /**
- * Returns the raw bytes of the encoded \a image
+ * Scales the given \a image to fit the given \a res resolution.
+ *
+ * Exact 2:1 and 4:1 reductions (e.g. 1280x960 to 640x480 or 320x240) use
+ * the box filter kernels of the area downscaler, which do not alias like the
+ * nearest-neighbour filter of \c QImage::scaled and result in smaller JPEG
+ * images. Other ratios need the weighted filter, which is several times
+ * slower than nearest-neighbour scaling, so they use \c QImage::scaled.
+ *
+ * Run the benchmark in \c tests/downscale to compare the filters on a device
+ */
+QImage QCCTV_ScaleImage (const QImage& image, const int res)
+{
+    /* Get resolution */
+    QSize size = QCCTV_GetResolution (res);
+    if (res == QCCTV_Original || image.isNull())
+        return image;
+
+    /* Get the final size of the image */
+    size = image.size().scaled (size, Qt::KeepAspectRatio);
+    if (size == image.size())
+        return image;
+
+    /* Get the number of channels of the image */
+    int channels = 0;
+    switch (image.format()) {
+    case QImage::Format_Grayscale8:
+        channels = 1;
+        break;
+    case QImage::Format_RGB888:
+        channels = 3;
+        break;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        channels = 4;
+        break;
+    default:
+        break;
+    }
+
+    /* Check if the box filter can be used */
+    const bool exact = (image.width() == size.width() * 2 &&
+                        image.height() == size.height() * 2) ||
+                       (image.width() == size.width() * 4 &&
+                        image.height() == size.height() * 4);
+
+    /* Downscale the image */
+    if (channels > 0 && exact) {
+        QImage scaled (size, image.format());
+        if (area_downscale (scaled.bits(),
+                            scaled.width(),
+                            scaled.height(),
+                            scaled.bytesPerLine(),
+                            image.constBits(),
+                            image.width(),
+                            image.height(),
+                            image.bytesPerLine(),
+                            channels))
+            return scaled;
+    }
+
+    /* Upscale the image, use another ratio or an unsupported pixel format */
+    return image.scaled (size, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+}
+
+/**
+ * Converts the given YUV \a image to an RGB image
+ */
+QImage QCCTV_YUVToImage (const QCCTV_YUVImage& image)
+{
+    if (image.isNull())
+        return QImage();
+
+    QImage rgb (image.width, image.height, QImage::Format_RGB888);
+    i420_to_rgb (rgb.bits(),
+                 rgb.bytesPerLine(),
+                 (const uchar*) image.y.constData(),
+                 image.width,
+                 (const uchar*) image.u.constData(),
+                 image.width / 2,
+                 (const uchar*) image.v.constData(),
+                 image.width / 2,
+                 image.width,
+                 image.height);
+
+    return rgb;
+}
+
+/**
+ * Allocates a YUV image with the given size (which is rounded down to even
+ * numbers)
  */
-QByteArray QCCTV_EncodeImage (const QImage& image, const int res)
+QCCTV_YUVImage QCCTV_CreateYUVImage (const int width, const int height)
+{
+    QCCTV_YUVImage image;
+    image.width = qMax (width, 0) & ~1;
+    image.height = qMax (height, 0) & ~1;
+    image.y.resize (image.width * image.height);
+    image.u.resize (image.width * image.height / 4);
+    image.v.resize (image.width * image.height / 4);
+    return image;
+}
+
+/**
+ * Scales the given YUV \a image to fit the given \a res resolution, each
+ * plane is downscaled with an area-averaging filter.
+ *
+ * \note YUV images are never upscaled, if the image is smaller than the
+ *       given resolution, the original image is returned
+ */
+QCCTV_YUVImage QCCTV_ScaleYUVImage (const QCCTV_YUVImage& image,
+                                    const int res)
 {
     /* Get resolution */
     QSize size = QCCTV_GetResolution (res);
-    if (res == QCCTV_Original)
-        size = image.size();
+    if (res == QCCTV_Original || image.isNull())
+        return image;
+
+    /* Get the final size of the image */
+    QSize original (image.width, image.height);
+    size = original.scaled (size, Qt::KeepAspectRatio);
+    size = QSize (size.width() & ~1, size.height() & ~1);
+    if (size.isEmpty() || size == original)
+        return image;
+    if (size.width() > original.width() || size.height() > original.height())
+        return image;
 
+    /* Downscale each plane */
+    QCCTV_YUVImage scaled = QCCTV_CreateYUVImage (size.width(), size.height());
+    area_downscale ((uchar*) scaled.y.data(),
+                    scaled.width, scaled.height, scaled.width,
+                    (const uchar*) image.y.constData(),
+                    image.width, image.height, image.width, 1);
+    area_downscale ((uchar*) scaled.u.data(),
+                    scaled.width / 2, scaled.height / 2, scaled.width / 2,
+                    (const uchar*) image.u.constData(),
+                    image.width / 2, image.height / 2, image.width / 2, 1);
+    area_downscale ((uchar*) scaled.v.data(),
+                    scaled.width / 2, scaled.height / 2, scaled.width / 2,
+                    (const uchar*) image.v.constData(),
+                    image.width / 2, image.height / 2, image.width / 2, 1);
+
+    return scaled;
+}
+
+/**
+ * Returns the raw bytes of the \a image encoded as a JPEG with the given
+ * \a quality (from 0 to 100)
+ */
+QByteArray QCCTV_EncodeImage (const QImage& image, const int res,
+                              const int quality)
+{
     /* Scale the image */
-    QImage final = image.scaled (size,
-                                 Qt::KeepAspectRatio,
-                                 Qt::FastTransformation);
+    QImage final = QCCTV_ScaleImage (image, res);
 
     /* Save image to byte array */
     QByteArray raw_bytes;
     QBuffer buffer (&raw_bytes);
-    final.save (&buffer, "jpg", 100);
+    final.save (&buffer, "jpg", qBound (0, quality, 100));
     buffer.close();
 
     /* Return image bytes */
     return raw_bytes;
 }
 
+/**
+ * Returns the raw bytes of the YUV \a image encoded as a JPEG with the given
+ * \a quality (from 0 to 100).
+ *
+ * If QCCTV was built with TurboJPEG support, the YUV planes are compressed
+ * directly (without converting the image to RGB and back to YUV). Otherwise,
+ * the image is converted to RGB and encoded with \c QCCTV_EncodeImage
+ */
+QByteArray QCCTV_EncodeYUVImage (const QCCTV_YUVImage& image, const int res,
+                                 const int quality)
+{
+#ifdef QCCTV_ENABLE_TURBOJPEG
+    /* Scale the image */
+    QCCTV_YUVImage final = QCCTV_ScaleYUVImage (image, res);
+    if (final.isNull())
+        return QByteArray();
+
+    /* Get the compressor of this thread */
+    if (!COMPRESSORS.hasLocalData())
+        COMPRESSORS.setLocalData (new QCCTV_JpegCompressor);
+
+    QCCTV_JpegCompressor* compressor = COMPRESSORS.localData();
+    if (!compressor->handle)
+        return QByteArray();
+
+    /* Make sure that the output buffer is large enough */
+    unsigned long capacity = tjBufSize (final.width, final.height, TJSAMP_420);
+    if (compressor->size < capacity) {
+        tjFree (compressor->buffer);
+        compressor->buffer = tjAlloc (capacity);
+        compressor->size = compressor->buffer ? capacity : 0;
+    }
+
+    /* Compress the planes */
+    const unsigned char* planes[3] = {
+        (const unsigned char*) final.y.constData(),
+        (const unsigned char*) final.u.constData(),
+        (const unsigned char*) final.v.constData()
+    };
+
+    const int strides[3] = { final.width, final.width / 2, final.width / 2 };
+
+    unsigned long length = compressor->size;
+    int error = tjCompressFromYUVPlanes (compressor->handle,
+                                         planes,
+                                         final.width,
+                                         strides,
+                                         final.height,
+                                         TJSAMP_420,
+                                         &compressor->buffer,
+                                         &length,
+                                         qBound (1, quality, 100),
+                                         TJFLAG_NOREALLOC | TJFLAG_FASTDCT);
+
+    /* Return image bytes */
+    if (error != 0)
+        return QByteArray();
+
+    return QByteArray ((const char*) compressor->buffer, (int) length);
+#else
+    return QCCTV_EncodeImage (QCCTV_YUVToImage (image), res, quality);
+#endif
+}
+
+/**
+ * Returns the uncompressed RGB pixels of the \a image (compressed with LZ4),
+ * this is useful for sources that are not well suited for JPEG compression.
+ *
+ * The width and height of the image are stored at the start of the data.
+ *
+ * \note If QCCTV was built without LZ4 support, or if the compressed pixels
+ *       do not fit in \c QCCTV_MAX_BUFFER_SIZE bytes (which happens with most
+ *       images larger than CIF), this function shall return an empty byte
+ *       array, so that the caller can fall back to JPEG
+ */
+QByteArray QCCTV_EncodeRawImage (const QImage& image, const int res)
+{
+#ifdef QCCTV_ENABLE_LZ4
+    /* Scale the image and get its pixels in a known format */
+    QImage final = QCCTV_ScaleImage (image, res);
+    final = final.convertToFormat (QImage::Format_RGB888);
+
+    /* Allocate the output buffer (LZ4 stops when the buffer is full) */
+    const int length = final.byteCount();
+    QByteArray data (qMin (8 + LZ4_compressBound (length),
+                           (int) QCCTV_MAX_BUFFER_SIZE), 0);
+    uchar* ptr = (uchar*) data.data();
+
+    /* Write image size */
+    qToBigEndian<quint32> (final.width(), ptr);
+    qToBigEndian<quint32> (final.height(), ptr + 4);
+
+    /* Compress the pixels */
+    int bytes = LZ4_compress_default ((const char*) final.constBits(),
+                                      data.data() + 8,
+                                      length,
+                                      data.length() - 8);
+
+    /* Compression failed */
+    if (bytes <= 0)
+        return QByteArray();
+
+    /* Return image bytes */
+    data.resize (8 + bytes);
+    return data;
+#else
+    Q_UNUSED (res);
+    Q_UNUSED (image);
+    return QByteArray();
+#endif
+}
+
+/**
+ * Generates an image from the given LZ4-compressed pixel \a data
+ *
+ * \note This function shall return a null image if the \a data is invalid
+ */
+QImage QCCTV_DecodeRawImage (const QByteArray& data)
+{
+#ifdef QCCTV_ENABLE_LZ4
+    if (data.length() > 8) {
+        /* Get image size */
+        const uchar* ptr = (const uchar*) data.constData();
+        const quint32 width = qFromBigEndian<quint32> (ptr);
+        const quint32 height = qFromBigEndian<quint32> (ptr + 4);
+
+        /* Reject sizes that we could not have received */
+        if (width == 0 || height == 0 ||
+            width > QCCTV_MAX_IMAGE_SIDE || height > QCCTV_MAX_IMAGE_SIDE)
+            return QImage();
+
+        /* LZ4 cannot compress data more than 255 times */
+        const qint64 stride = (width * 3 + 3) & ~3;
+        if (stride * height > (qint64) (data.length() - 8) * 255)
+            return QImage();
+
+        /* Decompress the pixels directly into the image */
+        QImage image (width, height, QImage::Format_RGB888);
+        if (!image.isNull()) {
+            int bytes = LZ4_decompress_safe (data.constData() + 8,
+                                             (char*) image.bits(),
+                                             data.length() - 8,
+                                             image.byteCount());
+
+            if (bytes == image.byteCount())
+                return image;
+        }
+    }
+#else
+    Q_UNUSED (data);
+#endif
+
+    return QImage();
+}
+
 /**
  * Generates a image from the given \a data
  */
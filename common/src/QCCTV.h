@@ -35,15 +35,75 @@
 #define QCCTV_COMMAND_PORT   1150
 #define QCCTV_REQUEST_PORT   1200
 #define QCCTV_DISCOVERY_PORT 1250
+#define QCCTV_MULTICAST_PORT 1300
 
 /*
  * Image encoding
  */
 #define QCCTV_MIN_FPS         5
 #define QCCTV_MAX_FPS         30
-#define QCCTV_MAX_BUFFER_SIZE 250 * 1024
+#define QCCTV_MIN_QUALITY     10
+#define QCCTV_MAX_QUALITY     95
+#define QCCTV_MAX_BUFFER_SIZE (250 * 1024)
+#define QCCTV_MAX_IMAGE_SIDE  4096
 #define QCCTV_RECORDINGS_PATH QDir::homePath() + "/Documents/QCCTV/"
 
+/*
+ * Stream framing
+ */
+#define QCCTV_FRAME_MAGIC       0x51435456
+#define QCCTV_FRAME_VERSION     1
+#define QCCTV_FRAME_HEADER_SIZE 24
+#define QCCTV_RECEIVE_BUFFER_SIZE (QCCTV_FRAME_HEADER_SIZE + QCCTV_MAX_BUFFER_SIZE)
+
+/*
+ * UDP video transport
+ */
+#define QCCTV_DATAGRAM_MAGIC       0x51435544
+#define QCCTV_DATAGRAM_SIZE        1400
+#define QCCTV_DATAGRAM_HEADER_SIZE 12
+#define QCCTV_REASSEMBLY_TIMEOUT   250
+#define QCCTV_MAX_PARTIAL_FRAMES   4
+#define QCCTV_MULTICAST_BASE       0xefff4300
+
+/*
+ * Info and command packets
+ */
+#define QCCTV_PACKET_MAGIC       0x4b504351
+#define QCCTV_PACKET_VERSION     1
+#define QCCTV_PACKET_HEADER_SIZE 8
+#define QCCTV_PACKET_MAX_SIZE    512
+#define QCCTV_PACKET_MAX_STRING  64
+#define QCCTV_INFO_HEARTBEAT     1000
+#define QCCTV_COMMAND_COALESCE   20
+#define QCCTV_COMMAND_RETRY      100
+
+/*
+ * Discovery timings (cameras beacon faster while nobody is watching them)
+ */
+#define QCCTV_BEACON_INTERVAL      1000
+#define QCCTV_BEACON_MAX_INTERVAL  8000
+#define QCCTV_BEACON_SLOW_INTERVAL 30000
+#define QCCTV_PROBE_INTERVAL       250
+#define QCCTV_PROBE_RETRIES        3
+#define QCCTV_PROBE_JITTER         100
+
+/*
+ * Reconnection (stations remember the cameras they found in a registry)
+ */
+#define QCCTV_RECONNECT_INTERVAL     250
+#define QCCTV_RECONNECT_MAX_INTERVAL 8000
+#define QCCTV_RECONNECT_ATTEMPTS     10
+#define QCCTV_REGISTRY_KEY           "QCCTV_Cameras"
+
+/*
+ * Delta encoding
+ */
+#define QCCTV_DELTA_TILE_SIZE   32
+#define QCCTV_DELTA_THRESHOLD   4
+#define QCCTV_KEYFRAME_INTERVAL 150
+#define QCCTV_RECOVERY_INTERVAL 10
+
 /*
  * Watchdog timings
  */
@@ -70,6 +130,55 @@ enum QCCTV_CameraStatus {
     QCCTV_CAMSTATUS_LIGHT_FAILURE = 0b100,
 };
 
+/*
+ * Frame header flags
+ */
+enum QCCTV_FrameFlags {
+    QCCTV_FRAME_KEYFRAME = 0b1,
+    QCCTV_FRAME_DELTA    = 0b10,
+};
+
+/*
+ * Stream channels, the stream connection can carry info and command packets
+ * besides the image frames
+ */
+enum QCCTV_Channel {
+    QCCTV_CHANNEL_VIDEO   = 0x00,
+    QCCTV_CHANNEL_INFO    = 0x01,
+    QCCTV_CHANNEL_COMMAND = 0x02,
+};
+
+/*
+ * Station capability flags
+ */
+enum QCCTV_Capabilities {
+    QCCTV_CAPABILITY_DELTA     = 0b1,
+    QCCTV_CAPABILITY_MULTICAST = 0b10,
+};
+
+/*
+ * Info, command and discovery packet types
+ */
+enum QCCTV_PacketType {
+    QCCTV_PACKET_INFO     = 0x01,
+    QCCTV_PACKET_COMMAND  = 0x02,
+    QCCTV_PACKET_ANNOUNCE = 0x03,
+    QCCTV_PACKET_PROBE    = 0x04,
+};
+
+/*
+ * Command packet fields, only the fields set in the command mask are applied
+ */
+enum QCCTV_CommandFields {
+    QCCTV_COMMAND_FPS        = 0b1,
+    QCCTV_COMMAND_ZOOM       = 0b10,
+    QCCTV_COMMAND_FOCUS      = 0b100,
+    QCCTV_COMMAND_BITRATE    = 0b1000,
+    QCCTV_COMMAND_RESOLUTION = 0b10000,
+    QCCTV_COMMAND_FLASHLIGHT = 0b100000,
+    QCCTV_COMMAND_AUTOREGRES = 0b1000000,
+};
+
 /*
  * Image resolutions
  */
@@ -84,16 +193,75 @@ enum QCCTV_Resolution {
     QCCTV_Original = 0x07
 };
 
+/*
+ * Image payload codecs
+ */
+enum QCCTV_Codec {
+    QCCTV_CODEC_ZLIB = 0x00,
+    QCCTV_CODEC_JPEG = 0x01,
+    QCCTV_CODEC_LZ4  = 0x02,
+};
+
+/*
+ * Frame integrity algorithms
+ */
+enum QCCTV_ChecksumAlgorithm {
+    QCCTV_CHECKSUM_CRC32  = 0x00,
+    QCCTV_CHECKSUM_CRC32C = 0x01,
+    QCCTV_CHECKSUM_XXHASH = 0x02,
+};
+
+/*
+ * Video transports
+ */
+enum QCCTV_Transport {
+    QCCTV_TRANSPORT_TCP = 0x00,
+    QCCTV_TRANSPORT_UDP = 0x01,
+    QCCTV_TRANSPORT_MULTICAST = 0x02,
+};
+
+/*
+ * Planar YUV 4:2:0 image with even dimensions, the chroma planes are half
+ * the width and half the height of the luma plane
+ */
+struct QCCTV_YUVImage {
+    QCCTV_YUVImage() : width (0), height (0) {}
+    bool isNull() const
+    {
+        return width <= 0 || height <= 0;
+    }
+
+    int width;
+    int height;
+    QByteArray y;
+    QByteArray u;
+    QByteArray v;
+};
+
 /*
  * Misc functions
  */
 extern QStringList QCCTV_Resolutions();
 extern int QCCTV_ValidFps (const int fps);
+extern int QCCTV_SupportedCodecs();
+extern int QCCTV_SupportedChecksums();
+extern qint64 QCCTV_Timestamp();
 extern int QCCTV_GetWatchdogTime (const int fps);
 extern QSize QCCTV_GetResolution (const int resolution);
 extern QString QCCTV_GetStatusString (const int status);
 extern QImage QCCTV_DecodeImage (const QByteArray& data);
-extern QByteArray QCCTV_EncodeImage (const QImage& image, const int res);
+extern QImage QCCTV_DecodeRawImage (const QByteArray& data);
+extern QImage QCCTV_ScaleImage (const QImage& image, const int res);
+extern QImage QCCTV_YUVToImage (const QCCTV_YUVImage& image);
+extern QCCTV_YUVImage QCCTV_CreateYUVImage (const int width, const int height);
+extern QCCTV_YUVImage QCCTV_ScaleYUVImage (const QCCTV_YUVImage& image,
+                                           const int res);
+extern QByteArray QCCTV_EncodeImage (const QImage& image, const int res,
+                                     const int quality);
+extern QByteArray QCCTV_EncodeRawImage (const QImage& image, const int res);
+extern QByteArray QCCTV_EncodeYUVImage (const QCCTV_YUVImage& image,
+                                        const int res,
+                                        const int quality);
 extern QImage QCCTV_CreateStatusImage (const QSize& size, const QString& text);
 
 #endif
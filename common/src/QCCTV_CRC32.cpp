@@ -22,20 +22,326 @@
 
 #include "QCCTV_CRC32.h"
 
+#include <QtEndian>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+    #define QCCTV_CRC32_PCLMUL
+    #include <immintrin.h>
+#elif defined (__aarch64__) && (defined (__ARM_FEATURE_CRYPTO) || \
+                                defined (__ARM_FEATURE_AES))
+    #define QCCTV_CRC32_PMULL
+    #include <arm_neon.h>
+#endif
+
+/*
+ * Polynomial used by the CRC32 (in reflected form) and the minimum number of
+ * bytes for which the carry-less multiplication kernels are worth it
+ */
+static const quint32 POLYNOMIAL = 0xEDB88320UL;
+static const int FOLD_MIN_BYTES = 64;
+
+/*
+ * Folding constants for the carry-less multiplication kernels, these are
+ * the remainders of x^(512+32), x^(512-32), x^(128+32), x^(128-32) and
+ * x^64 modulo the polynomial, followed by the Barrett reduction constants
+ */
+static const quint64 K1K2[2] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+static const quint64 K3K4[2] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+static const quint64 K5K0[2] = { 0x0163cd6124ULL, 0x0000000000ULL };
+static const quint64 POLY[2] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+typedef quint32 (*FoldFunction) (quint32 crc, const uchar* data, int len);
+
 /**
- * Generates the CRC table during initialization
+ * Lookup tables used by the slicing-by-8 implementation, the first table is
+ * the classic byte-at-a-time table and each of the others advances the CRC
+ * of the previous one by another byte
  */
-QCCTV_CRC32::QCCTV_CRC32()
+static struct CRC32Tables {
+    quint32 table [8][256];
+
+    CRC32Tables()
+    {
+        for (int i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = crc & 1 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+
+            table [0][i] = crc;
+        }
+
+        for (int i = 0; i < 256; ++i)
+            for (int t = 1; t < 8; ++t)
+                table [t][i] = (table [t - 1][i] >> 8) ^
+                               table [0][table [t - 1][i] & 0xFF];
+    }
+} TABLES;
+
+/**
+ * Folds the given data into the \a crc register eight bytes at a time
+ */
+static quint32 slice_by_8 (quint32 crc, const uchar* data, int len)
+{
+    const quint32 (*t)[256] = TABLES.table;
+
+    while (len >= 8) {
+        const quint32 one = qFromLittleEndian<quint32> (data) ^ crc;
+        const quint32 two = qFromLittleEndian<quint32> (data + 4);
+
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^
+              t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^
+              t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+
+        data += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+        crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+#if defined (QCCTV_CRC32_PCLMUL)
+/**
+ * Folds the given data into the \a crc register using the PCLMULQDQ
+ * instruction. The \a len must be a multiple of 16 and at least 64 bytes
+ */
+__attribute__ ((target ("pclmul,sse4.1")))
+static quint32 fold_pclmul (quint32 crc, const uchar* data, int len)
 {
-    quint32 crc;
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    /* Load the first four blocks and add the initial CRC */
+    x1 = _mm_loadu_si128 ((const __m128i*) (data + 0x00));
+    x2 = _mm_loadu_si128 ((const __m128i*) (data + 0x10));
+    x3 = _mm_loadu_si128 ((const __m128i*) (data + 0x20));
+    x4 = _mm_loadu_si128 ((const __m128i*) (data + 0x30));
+    x1 = _mm_xor_si128 (x1, _mm_cvtsi32_si128 (crc));
+    x0 = _mm_loadu_si128 ((const __m128i*) K1K2);
+
+    data += 64;
+    len -= 64;
+
+    /* Fold four blocks at a time */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128 (x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128 (x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128 (x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128 (x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128 (x4, x0, 0x11);
+
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5),
+                            _mm_loadu_si128 ((const __m128i*) (data + 0x00)));
+        x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6),
+                            _mm_loadu_si128 ((const __m128i*) (data + 0x10)));
+        x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7),
+                            _mm_loadu_si128 ((const __m128i*) (data + 0x20)));
+        x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8),
+                            _mm_loadu_si128 ((const __m128i*) (data + 0x30)));
+
+        data += 64;
+        len -= 64;
+    }
+
+    /* Fold the four blocks into one */
+    x0 = _mm_loadu_si128 ((const __m128i*) K3K4);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+    x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x4), x5);
+
+    /* Fold the remaining blocks one at a time */
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128 (x1, x0, 0x11);
+        x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5),
+                            _mm_loadu_si128 ((const __m128i*) data));
+
+        data += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits into 64 bits */
+    x2 = _mm_clmulepi64_si128 (x1, x0, 0x10);
+    x3 = _mm_setr_epi32 (~0, 0, ~0, 0);
+    x1 = _mm_xor_si128 (_mm_srli_si128 (x1, 8), x2);
+
+    x0 = _mm_loadl_epi64 ((const __m128i*) K5K0);
+    x2 = _mm_srli_si128 (x1, 4);
+    x1 = _mm_and_si128 (x1, x3);
+    x1 = _mm_clmulepi64_si128 (x1, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_loadu_si128 ((const __m128i*) POLY);
+    x2 = _mm_and_si128 (x1, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x10);
+    x2 = _mm_and_si128 (x2, x3);
+    x2 = _mm_clmulepi64_si128 (x2, x0, 0x00);
+    x1 = _mm_xor_si128 (x1, x2);
+
+    return _mm_extract_epi32 (x1, 1);
+}
+#endif
+
+#if defined (QCCTV_CRC32_PMULL)
+/**
+ * Carry-less multiplication of two 64-bit lanes, equivalent to PCLMULQDQ
+ * with an immediate of 0x00 (low lanes), 0x11 (high lanes) and 0x10 (low
+ * lane of \a a and high lane of \a b)
+ */
+static inline uint64x2_t clmul_00 (const uint64x2_t a, const uint64x2_t b)
+{
+    return vreinterpretq_u64_p128 (vmull_p64 ((poly64_t) vgetq_lane_u64 (a, 0),
+                                              (poly64_t) vgetq_lane_u64 (b, 0)));
+}
+
+static inline uint64x2_t clmul_11 (const uint64x2_t a, const uint64x2_t b)
+{
+    return vreinterpretq_u64_p128 (vmull_p64 ((poly64_t) vgetq_lane_u64 (a, 1),
+                                              (poly64_t) vgetq_lane_u64 (b, 1)));
+}
+
+static inline uint64x2_t clmul_10 (const uint64x2_t a, const uint64x2_t b)
+{
+    return vreinterpretq_u64_p128 (vmull_p64 ((poly64_t) vgetq_lane_u64 (a, 0),
+                                              (poly64_t) vgetq_lane_u64 (b, 1)));
+}
+
+/**
+ * Folds the given data into the \a crc register using the PMULL
+ * instruction. The \a len must be a multiple of 16 and at least 64 bytes
+ */
+static quint32 fold_pmull (quint32 crc, const uchar* data, int len)
+{
+    uint64x2_t x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    /* Load the first four blocks and add the initial CRC */
+    x1 = vreinterpretq_u64_u8 (vld1q_u8 (data + 0x00));
+    x2 = vreinterpretq_u64_u8 (vld1q_u8 (data + 0x10));
+    x3 = vreinterpretq_u64_u8 (vld1q_u8 (data + 0x20));
+    x4 = vreinterpretq_u64_u8 (vld1q_u8 (data + 0x30));
+    x1 = veorq_u64 (x1, vcombine_u64 (vcreate_u64 (crc), vcreate_u64 (0)));
+    x0 = vld1q_u64 (K1K2);
 
-    for (int i = 0; i < 256; i++) {
-        crc = i;
-        for (int j = 0; j < 8; j++)
-            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+    data += 64;
+    len -= 64;
 
-        crc_table[i] = crc;
+    /* Fold four blocks at a time */
+    while (len >= 64) {
+        x5 = clmul_00 (x1, x0);
+        x6 = clmul_00 (x2, x0);
+        x7 = clmul_00 (x3, x0);
+        x8 = clmul_00 (x4, x0);
+
+        x1 = clmul_11 (x1, x0);
+        x2 = clmul_11 (x2, x0);
+        x3 = clmul_11 (x3, x0);
+        x4 = clmul_11 (x4, x0);
+
+        x1 = veorq_u64 (veorq_u64 (x1, x5),
+                        vreinterpretq_u64_u8 (vld1q_u8 (data + 0x00)));
+        x2 = veorq_u64 (veorq_u64 (x2, x6),
+                        vreinterpretq_u64_u8 (vld1q_u8 (data + 0x10)));
+        x3 = veorq_u64 (veorq_u64 (x3, x7),
+                        vreinterpretq_u64_u8 (vld1q_u8 (data + 0x20)));
+        x4 = veorq_u64 (veorq_u64 (x4, x8),
+                        vreinterpretq_u64_u8 (vld1q_u8 (data + 0x30)));
+
+        data += 64;
+        len -= 64;
+    }
+
+    /* Fold the four blocks into one */
+    x0 = vld1q_u64 (K3K4);
+
+    x5 = clmul_00 (x1, x0);
+    x1 = clmul_11 (x1, x0);
+    x1 = veorq_u64 (veorq_u64 (x1, x2), x5);
+
+    x5 = clmul_00 (x1, x0);
+    x1 = clmul_11 (x1, x0);
+    x1 = veorq_u64 (veorq_u64 (x1, x3), x5);
+
+    x5 = clmul_00 (x1, x0);
+    x1 = clmul_11 (x1, x0);
+    x1 = veorq_u64 (veorq_u64 (x1, x4), x5);
+
+    /* Fold the remaining blocks one at a time */
+    while (len >= 16) {
+        x5 = clmul_00 (x1, x0);
+        x1 = clmul_11 (x1, x0);
+        x1 = veorq_u64 (veorq_u64 (x1, x5),
+                        vreinterpretq_u64_u8 (vld1q_u8 (data)));
+
+        data += 16;
+        len -= 16;
     }
+
+    /* Fold 128 bits into 64 bits */
+    const uint64x2_t mask = vcombine_u64 (vcreate_u64 (0xFFFFFFFFULL),
+                                          vcreate_u64 (0xFFFFFFFFULL));
+    x2 = clmul_10 (x1, x0);
+    x1 = veorq_u64 (vcombine_u64 (vget_high_u64 (x1), vcreate_u64 (0)), x2);
+
+    x0 = vld1q_u64 (K5K0);
+    x2 = vreinterpretq_u64_u8 (vextq_u8 (vreinterpretq_u8_u64 (x1),
+                                         vdupq_n_u8 (0), 4));
+    x1 = vandq_u64 (x1, mask);
+    x1 = clmul_00 (x1, x0);
+    x1 = veorq_u64 (x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = vld1q_u64 (POLY);
+    x2 = vandq_u64 (x1, mask);
+    x2 = clmul_10 (x2, x0);
+    x2 = vandq_u64 (x2, mask);
+    x2 = clmul_00 (x2, x0);
+    x1 = veorq_u64 (x1, x2);
+
+    return vgetq_lane_u32 (vreinterpretq_u32_u64 (x1), 1);
+}
+#endif
+
+/**
+ * Returns the fastest folding kernel supported by the CPU, or \c NULL if we
+ * must use the slicing-by-8 implementation
+ */
+static FoldFunction select_kernel()
+{
+#if defined (QCCTV_CRC32_PCLMUL)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("pclmul") && __builtin_cpu_supports ("sse4.1"))
+        return &fold_pclmul;
+#elif defined (QCCTV_CRC32_PMULL)
+    return &fold_pmull;
+#endif
+
+    return NULL;
+}
+
+static const FoldFunction KERNEL = select_kernel();
+
+/**
+ * Initializes the state of the incremental checksum
+ */
+QCCTV_CRC32::QCCTV_CRC32()
+{
+    init();
 }
 
 /**
@@ -43,24 +349,89 @@ QCCTV_CRC32::QCCTV_CRC32()
  *
  * @param buf the data buffer
  */
-quint32 QCCTV_CRC32::compute (QByteArray buf)
+quint32 QCCTV_CRC32::compute (const QByteArray& buf)
 {
-    return compute (buf, buf.length());
+    return compute (buf.constData(), buf.length());
 }
 
 /**
- * Adds the byte array to the data checksum.
+ * Calculates the CRC of the first bytes of the given byte array
  *
  * @param buf the data buffer
- * @param off the offset in the buffer where the data starts
  * @param len the length of the data
  */
-quint32 QCCTV_CRC32::compute (QByteArray buf, int len)
+quint32 QCCTV_CRC32::compute (const QByteArray& buf, int len)
 {
-    quint32 crc = 0xFFFFFFFFUL;
+    return compute (buf.constData(), qMin (len, buf.length()));
+}
 
-    for (int i = 0; i < len; ++i)
-        crc = crc_table [ (crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+/**
+ * Calculates the CRC of the given raw data, without altering the state used
+ * by \c update()
+ *
+ * @param data the data buffer
+ * @param len the length of the data
+ */
+quint32 QCCTV_CRC32::compute (const char* data, int len)
+{
+    return update (0xFFFFFFFFUL, data, len) ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Resets the state of the incremental checksum
+ */
+void QCCTV_CRC32::init()
+{
+    m_crc = 0xFFFFFFFFUL;
+}
+
+/**
+ * Adds the given data to the incremental checksum. Feeding a buffer in
+ * several calls yields the same result as feeding it at once
+ *
+ * @param data the data buffer
+ * @param len the length of the data
+ */
+void QCCTV_CRC32::update (const char* data, int len)
+{
+    m_crc = update (m_crc, data, len);
+}
+
+/**
+ * Returns the CRC of the data added since the last call to \c init()
+ */
+quint32 QCCTV_CRC32::final() const
+{
+    return m_crc ^ 0xFFFFFFFFUL;
+}
+
+/**
+ * Returns \c true if the CPU supports one of the carry-less multiplication
+ * kernels, which are several times faster than the slicing-by-8 tables
+ */
+bool QCCTV_CRC32::isAccelerated()
+{
+    return KERNEL != NULL;
+}
+
+/**
+ * Folds the given data into the \a crc register and returns the new value.
+ *
+ * The largest multiple of 16 bytes is given to the folding kernel (if the
+ * CPU supports one), the rest is handled by the slicing-by-8 tables
+ */
+quint32 QCCTV_CRC32::update (quint32 crc, const char* data, int len)
+{
+    const uchar* ptr = (const uchar*) data;
+    if (!ptr || len <= 0)
+        return crc;
+
+    if (KERNEL && len >= FOLD_MIN_BYTES) {
+        const int folded = len & ~15;
+        crc = KERNEL (crc, ptr, folded);
+        ptr += folded;
+        len -= folded;
+    }
 
-    return crc ^ 0xFFFFFFFFUL;
+    return slice_by_8 (crc, ptr, len);
 }
@@ -15,21 +15,33 @@
  * \brief Computes the CRC32 data checksum of a data stream.
  *
  * Can be used to get the CRC32 over a stream if used with checked input/output
- * streams.
+ * streams. Data that arrives in pieces can be checksummed incrementally with
+ * \c init(), \c update() and \c final().
+ *
+ * Large buffers are folded with carry-less multiplication (PCLMULQDQ on x86,
+ * PMULL on ARMv8) when the CPU supports it, and with a slicing-by-8 table
+ * otherwise. Every implementation produces the same checksum.
  */
 class QCCTV_CRC32
 {
 public:
     explicit QCCTV_CRC32();
 
-    quint32 compute (QByteArray buf);
-    quint32 compute (QByteArray buf, int len);
+    quint32 compute (const QByteArray& buf);
+    quint32 compute (const QByteArray& buf, int len);
+    quint32 compute (const char* data, int len);
+
+    void init();
+    void update (const char* data, int len);
+    quint32 final() const;
+
+    static bool isAccelerated();
 
 private:
-    quint32 crc_table [256];
+    static quint32 update (quint32 crc, const char* data, int len);
 
 private:
-    void make_crc_table();
+    quint32 m_crc;
 };
 
 
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include "QCCTV.h"
+#include "QCCTV_Checksum.h"
+
+#include <QtEndian>
+#include <string.h>
+
+#ifdef QCCTV_ENABLE_XXHASH
+    #include <xxhash.h>
+#endif
+
+#if defined (__GNUC__) && defined (__x86_64__)
+    #define QCCTV_CRC32C_SSE42
+    #include <nmmintrin.h>
+#elif defined (__aarch64__) && defined (__ARM_FEATURE_CRC32)
+    #define QCCTV_CRC32C_ARMV8
+    #include <arm_acle.h>
+#endif
+
+/*
+ * Castagnoli polynomial (in reflected form) used by CRC32C
+ */
+static const quint32 CASTAGNOLI = 0x82F63B78UL;
+
+typedef quint32 (*CRC32CFunction) (quint32 crc, const uchar* data, int len);
+
+/**
+ * Lookup tables used by the slicing-by-8 implementation of CRC32C
+ */
+static struct CRC32CTables {
+    quint32 table [8][256];
+
+    CRC32CTables()
+    {
+        for (int i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = crc & 1 ? (crc >> 1) ^ CASTAGNOLI : crc >> 1;
+
+            table [0][i] = crc;
+        }
+
+        for (int i = 0; i < 256; ++i)
+            for (int t = 1; t < 8; ++t)
+                table [t][i] = (table [t - 1][i] >> 8) ^
+                               table [0][table [t - 1][i] & 0xFF];
+    }
+} CRC32C_TABLES;
+
+/**
+ * Folds the given data into the CRC32C register eight bytes at a time
+ */
+static quint32 crc32c_slice_by_8 (quint32 crc, const uchar* data, int len)
+{
+    const quint32 (*t)[256] = CRC32C_TABLES.table;
+
+    while (len >= 8) {
+        const quint32 one = qFromLittleEndian<quint32> (data) ^ crc;
+        const quint32 two = qFromLittleEndian<quint32> (data + 4);
+
+        crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^
+              t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+              t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^
+              t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+
+        data += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+        crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+#if defined (QCCTV_CRC32C_SSE42)
+/**
+ * Folds the given data into the CRC32C register with the SSE4.2 CRC32
+ * instruction, eight bytes at a time
+ */
+__attribute__ ((target ("sse4.2")))
+static quint32 crc32c_sse42 (quint32 crc, const uchar* data, int len)
+{
+    quint64 crc64 = crc;
+    while (len >= 8) {
+        quint64 value;
+        memcpy (&value, data, sizeof (value));
+        crc64 = _mm_crc32_u64 (crc64, value);
+
+        data += 8;
+        len -= 8;
+    }
+
+    crc = (quint32) crc64;
+    while (len-- > 0)
+        crc = _mm_crc32_u8 (crc, *data++);
+
+    return crc;
+}
+#endif
+
+#if defined (QCCTV_CRC32C_ARMV8)
+/**
+ * Folds the given data into the CRC32C register with the ARMv8 CRC32
+ * instructions, eight bytes at a time
+ */
+static quint32 crc32c_armv8 (quint32 crc, const uchar* data, int len)
+{
+    while (len >= 8) {
+        quint64 value;
+        memcpy (&value, data, sizeof (value));
+        crc = __crc32cd (crc, value);
+
+        data += 8;
+        len -= 8;
+    }
+
+    while (len-- > 0)
+        crc = __crc32cb (crc, *data++);
+
+    return crc;
+}
+#endif
+
+/**
+ * Returns the fastest CRC32C implementation supported by the CPU
+ */
+static CRC32CFunction select_crc32c()
+{
+#if defined (QCCTV_CRC32C_SSE42)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports ("sse4.2"))
+        return &crc32c_sse42;
+#elif defined (QCCTV_CRC32C_ARMV8)
+    return &crc32c_armv8;
+#endif
+
+    return &crc32c_slice_by_8;
+}
+
+static const CRC32CFunction CRC32C = select_crc32c();
+
+/**
+ * Initializes the checksum with the CRC32 algorithm
+ */
+QCCTV_Checksum::QCCTV_Checksum()
+{
+    m_xxhash = NULL;
+    init (QCCTV_CHECKSUM_CRC32);
+}
+
+/**
+ * Releases the state of the xxHash algorithm (if any)
+ */
+QCCTV_Checksum::~QCCTV_Checksum()
+{
+#ifdef QCCTV_ENABLE_XXHASH
+    if (m_xxhash)
+        XXH3_freeState ((XXH3_state_t*) m_xxhash);
+#endif
+}
+
+/**
+ * Returns the algorithm that was given to the last call of \c init()
+ */
+quint8 QCCTV_Checksum::algorithm() const
+{
+    return m_algorithm;
+}
+
+/**
+ * Resets the incremental checksum and selects the given \a algorithm, which
+ * is a value of \c QCCTV_ChecksumAlgorithm
+ */
+void QCCTV_Checksum::init (const quint8 algorithm)
+{
+    m_algorithm = algorithm;
+    m_crc32c = 0xFFFFFFFFUL;
+    m_crc32.init();
+
+#ifdef QCCTV_ENABLE_XXHASH
+    if (algorithm == QCCTV_CHECKSUM_XXHASH) {
+        if (!m_xxhash)
+            m_xxhash = XXH3_createState();
+
+        if (m_xxhash)
+            XXH3_64bits_reset ((XXH3_state_t*) m_xxhash);
+    }
+#endif
+}
+
+/**
+ * Adds the given \a data to the incremental checksum
+ */
+void QCCTV_Checksum::update (const char* data, const int length)
+{
+    if (!data || length <= 0)
+        return;
+
+    switch (m_algorithm) {
+    case QCCTV_CHECKSUM_CRC32:
+        m_crc32.update (data, length);
+        break;
+    case QCCTV_CHECKSUM_CRC32C:
+        m_crc32c = CRC32C (m_crc32c, (const uchar*) data, length);
+        break;
+#ifdef QCCTV_ENABLE_XXHASH
+    case QCCTV_CHECKSUM_XXHASH:
+        if (m_xxhash)
+            XXH3_64bits_update ((XXH3_state_t*) m_xxhash, data, length);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+/**
+ * Returns the checksum of the data added since the last call to \c init(),
+ * the checksum of an unsupported algorithm is always \c 0
+ */
+quint32 QCCTV_Checksum::final() const
+{
+    switch (m_algorithm) {
+    case QCCTV_CHECKSUM_CRC32:
+        return m_crc32.final();
+    case QCCTV_CHECKSUM_CRC32C:
+        return m_crc32c ^ 0xFFFFFFFFUL;
+#ifdef QCCTV_ENABLE_XXHASH
+    case QCCTV_CHECKSUM_XXHASH:
+        if (m_xxhash)
+            return (quint32) XXH3_64bits_digest ((XXH3_state_t*) m_xxhash);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns \c true if this build of QCCTV implements the given \a algorithm
+ */
+bool QCCTV_Checksum::isSupported (const quint8 algorithm)
+{
+    return algorithm < 8 && (QCCTV_SupportedChecksums() & (1 << algorithm));
+}
+
+/**
+ * Returns the fastest algorithm of the given \a algorithms bitmask that is
+ * supported by this build of QCCTV, ranked by the implementations that were
+ * selected for this CPU:
+ *
+ * - XXH3 (if QCCTV was built with xxHash)
+ * - CRC32 folded with carry-less multiplications
+ * - CRC32C computed with the CRC32 instructions of the CPU
+ * - CRC32C computed with the slicing-by-8 tables
+ *
+ * If none of them is supported by the peer, we use CRC32
+ */
+quint8 QCCTV_Checksum::preferredAlgorithm (const int algorithms)
+{
+    const int common = algorithms & QCCTV_SupportedChecksums();
+
+    if (common & (1 << QCCTV_CHECKSUM_XXHASH))
+        return QCCTV_CHECKSUM_XXHASH;
+    if (QCCTV_CRC32::isAccelerated())
+        return QCCTV_CHECKSUM_CRC32;
+    if (common & (1 << QCCTV_CHECKSUM_CRC32C))
+        return QCCTV_CHECKSUM_CRC32C;
+
+    return QCCTV_CHECKSUM_CRC32;
+}
+
+/**
+ * Returns the checksum of the given \a data with the given \a algorithm,
+ * the checksum of an unsupported algorithm is always \c 0
+ */
+quint32 QCCTV_Checksum::compute (const quint8 algorithm, const char* data,
+                                 const int length)
+{
+    static QCCTV_CRC32 crc32;
+    const int len = data ? qMax (length, 0) : 0;
+
+    switch (algorithm) {
+    case QCCTV_CHECKSUM_CRC32:
+        return crc32.compute (data, len);
+    case QCCTV_CHECKSUM_CRC32C:
+        return CRC32C (0xFFFFFFFFUL, (const uchar*) data, len) ^ 0xFFFFFFFFUL;
+#ifdef QCCTV_ENABLE_XXHASH
+    case QCCTV_CHECKSUM_XXHASH:
+        return (quint32) XXH3_64bits (data, len);
+#endif
+    default:
+        break;
+    }
+
+    return 0;
+}
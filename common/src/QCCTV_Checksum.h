@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_CHECKSUM_H
+#define _QCCTV_CHECKSUM_H
+
+#include "QCCTV_CRC32.h"
+
+/**
+ * \brief Computes the integrity checksum of a frame with a given algorithm
+ *
+ * The algorithm of each frame is stored in its header, so that cameras and
+ * stations can agree on the fastest algorithm that both of them support.
+ * Plain CRC32 is always supported, and it is the algorithm used with peers
+ * that do not report their supported algorithms.
+ *
+ * Like \c QCCTV_CRC32, the checksum can be computed at once with
+ * \c compute() or incrementally with \c init(), \c update() and \c final().
+ * Only the lower 32 bits of 64-bit hashes are used.
+ */
+class QCCTV_Checksum
+{
+public:
+    explicit QCCTV_Checksum();
+    ~QCCTV_Checksum();
+
+    quint8 algorithm() const;
+
+    void init (const quint8 algorithm);
+    void update (const char* data, const int length);
+    quint32 final() const;
+
+    static bool isSupported (const quint8 algorithm);
+    static quint8 preferredAlgorithm (const int algorithms);
+    static quint32 compute (const quint8 algorithm, const char* data,
+                            const int length);
+
+private:
+    Q_DISABLE_COPY (QCCTV_Checksum)
+
+private:
+    quint8 m_algorithm;
+    quint32 m_crc32c;
+    QCCTV_CRC32 m_crc32;
+    void* m_xxhash;
+};
+
+#endif
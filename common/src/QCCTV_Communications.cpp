@@ -20,18 +20,57 @@
  * DEALINGS IN THE SOFTWARE
  */
 
-#include "QCCTV_CRC32.h"
+#include "QCCTV_Checksum.h"
+#include "QCCTV_DeltaEncoder.h"
 #include "QCCTV_Communications.h"
 
-#include <QJsonObject>
+#include <QtEndian>
 #include <QJsonArray>
-#include <QJsonDocument>
+#include <QJsonObject>
+
+/* Size of the fixed fields of the info and command packets */
+static const int INFO_SIZE = 32;
+static const int COMMAND_SIZE = 20;
+
+/* Size of the fixed fields of the discovery packets */
+static const int ANNOUNCE_SIZE = 16;
+static const int PROBE_SIZE = 0;
+
+/* Size of the info fixed fields sent by cameras without checksum support */
+static const int INFO_SIZE_CRC32 = 28;
+
+/* Info packet flags */
+static const quint8 INFO_ZOOM_AVAIL = 0b1;
+static const quint8 INFO_FLASHLIGHT = 0b10;
+static const quint8 INFO_AUTOREGRES = 0b100;
+
+/* Command packet flags */
+static const quint8 COMMAND_KEYFRAME_REQUEST = 0b1;
+static const quint8 COMMAND_FLASHLIGHT       = 0b10;
+static const quint8 COMMAND_AUTOREGRES       = 0b100;
+
+/* Info packet extension tags */
+static const quint8 TAG_NAME       = 0x01;
+static const quint8 TAG_GROUP      = 0x02;
+static const quint8 TAG_MCAST_ADDR = 0x03;
+
+/* Command packet extension tags */
+static const quint8 TAG_HOST = 0x01;
 
-static QCCTV_CRC32 crc32;
+/* Announce packet extension tags (name and group use the info tags) */
+static const quint8 TAG_RUNGS = 0x04;
 
-/* Stream packet keys */
+/* Debug dump keys */
+static const QString KEY_TYPE    = "type";
+static const QString KEY_VERSION = "version";
+
+/* Info packet keys (debug dump) */
 static const QString KEY_FPS        = "fps";
 static const QString KEY_ZOOM       = "zoom";
+static const QString KEY_CODEC      = "codec";
+static const QString KEY_CODECS     = "codecs";
+static const QString KEY_QUALITY    = "quality";
+static const QString KEY_BITRATE    = "bitrate";
 static const QString KEY_NAME       = "name";
 static const QString KEY_GROUP      = "group";
 static const QString KEY_STATUS     = "status";
@@ -39,20 +78,25 @@ static const QString KEY_RESOLUTION = "resolution";
 static const QString KEY_FLASHLIGHT = "flashlight";
 static const QString KEY_ZOOM_AVAIL = "zoomSupported";
 static const QString KEY_AUTOREGRES = "autoRegulateResolution";
+static const QString KEY_MCAST_PORT = "mcast_port";
+static const QString KEY_MCAST_ADDR = "mcast_group";
+static const QString KEY_CMD_ACK    = "ack";
+static const QString KEY_CHECKSUM   = "checksum";
+static const QString KEY_CHECKSUMS  = "checksums";
+
+/* Command packet keys (debug dump) */
+static const QString KEY_HOST              = "host";
+static const QString KEY_FIELDS            = "fields";
+static const QString KEY_SEQUENCE          = "seq";
+static const QString KEY_CAPABILITIES      = "caps";
+static const QString KEY_KEYFRAME_REQUEST  = "keyframe";
+static const QString KEY_VIDEO_PORT        = "udp_port";
 
-/* Command packet keys */
-static const QString KEY_HOST = "host";
-static const QString KEY_OLD_FPS = "o_fps";
-static const QString KEY_NEW_FPS = "n_fps";
-static const QString KEY_OLD_ZOOM = "o_zoom";
-static const QString KEY_NEW_ZOOM = "n_zoom";
-static const QString KEY_FOCUS_REQUEST  = "focus";
-static const QString KEY_OLD_RESOLUTION = "o_res";
-static const QString KEY_NEW_RESOLUTION = "n_res";
-static const QString KEY_OLD_FLASHLIGHT = "o_flashlight";
-static const QString KEY_NEW_FLASHLIGHT = "n_flashlight";
-static const QString KEY_OLD_AUTOREGRES = "o_autoRegulateResolution";
-static const QString KEY_NEW_AUTOREGRES = "n_autoRegulateResolution";
+/* Announce packet keys (debug dump) */
+static const QString KEY_ID           = "id";
+static const QString KEY_RUNGS        = "rungs";
+static const QString KEY_STREAM_PORT  = "stream_port";
+static const QString KEY_COMMAND_PORT = "command_port";
 
 /**
  * Initializes the default values for the given stream \a packet
@@ -62,8 +106,18 @@ void QCCTV_InitInfo (QCCTV_InfoPacket* packet)
     if (packet) {
         packet->fps = 10;
         packet->zoom = 0;
+        packet->bitrate = 0;
+        packet->version = 0;
+        packet->commandAck = 0;
+        packet->codec = QCCTV_CODEC_JPEG;
+        packet->quality = QCCTV_MAX_QUALITY;
+        packet->supportedCodecs = QCCTV_SupportedCodecs();
+        packet->checksum = QCCTV_CHECKSUM_CRC32;
+        packet->supportedChecksums = QCCTV_SupportedChecksums();
         packet->cameraName = "";
         packet->supportsZoom = false;
+        packet->multicastPort = 0;
+        packet->multicastGroup = "";
         packet->cameraGroup = "Default";
         packet->flashlightEnabled = false;
         packet->resolution = QCCTV_Original;
@@ -79,6 +133,10 @@ void QCCTV_InitImage (QCCTV_ImagePacket* packet)
 {
     if (packet) {
         packet->crc32 = 0;
+        packet->flags = 0;
+        packet->codec = QCCTV_CODEC_JPEG;
+        packet->sequence = 0;
+        packet->timestamp = 0;
         packet->image = QCCTV_CreateStatusImage (QSize (640, 480),
                                                  "NO CAMERA IMAGE");
     }
@@ -92,30 +150,385 @@ void QCCTV_InitCommand (QCCTV_CommandPacket* command,
                         QCCTV_InfoPacket* stream)
 {
     if (command && stream) {
-        command->focusRequest = false;
-        command->newFps = stream->fps;
-        command->oldFps = stream->fps;
-        command->oldZoom = stream->zoom;
-        command->newZoom = stream->zoom;
-        command->oldResolution = stream->resolution;
-        command->newResolution = stream->resolution;
-        command->oldFlashlightEnabled = stream->flashlightEnabled;
-        command->newFlashlightEnabled = stream->flashlightEnabled;
-        command->oldAutoRegulateResolution = stream->autoRegulateResolution;
-        command->newAutoRegulateResolution = stream->autoRegulateResolution;
+        command->fields = 0;
+        command->sequence = 0;
+        command->quality = 0;
+        command->videoPort = 0;
+        command->keyframeRequest = false;
+        command->capabilities = QCCTV_CAPABILITY_DELTA;
+        command->supportedCodecs = QCCTV_SupportedCodecs();
+        command->supportedChecksums = QCCTV_SupportedChecksums();
+        command->fps = stream->fps;
+        command->zoom = stream->zoom;
+        command->bitrate = stream->bitrate;
+        command->resolution = stream->resolution;
+        command->flashlightEnabled = stream->flashlightEnabled;
+        command->autoRegulateResolution = stream->autoRegulateResolution;
     }
 }
 
 /**
- * Generates an image packet using \c QCCTV_CreateImagePacket and writes it
- * on the given \a output byte array
+ * Returns the key of the stream rung that encodes images with the given
+ * \a resolution and JPEG \a quality (0 means that the quality is selected
+ * by the rate controller) every \a divisor camera frames.
+ *
+ * Keys are sorted by resolution first, so that a map of rungs can be
+ * iterated from the lowest to the highest resolution
+ */
+int QCCTV_RungKey (const int resolution, const int quality, const int divisor)
+{
+    return ((resolution & 0xff) << 16) | ((quality & 0xff) << 8) |
+           (divisor & 0xff);
+}
+
+/**
+ * Generates an image packet for each of the given stream \a rungs using
+ * \c QCCTV_CreateImagePacket and returns the encoded frames, indexed by
+ * the key of each rung.
+ *
+ * Each rung only encodes one of every \c divisor frames (counted with the
+ * sequence number of the \a image), and uses its own JPEG quality unless
+ * its quality is set to 0.
+ *
+ * The \a rungs must be sorted from the lowest to the highest resolution.
+ * The highest resolution is scaled from the original image, and each lower
+ * rung is scaled from the rung above it, so that every rung is scaled and
+ * encoded only once, regardless of the number of stations that receive it.
+ *
+ * If the image packet only contains a YUV image, the YUV planes are scaled
+ * instead of the RGB image
+ */
+QCCTV_FrameLadder QCCTV_CreateImageLadder
+(QList<QSharedPointer<QCCTV_StreamRung> > rungs,
+ const QCCTV_ImagePacket* image,
+ const QCCTV_InfoPacket* info,
+ const bool deltaFrames)
+{
+    QCCTV_FrameLadder ladder;
+
+    /* Images are already scaled when we create the packets */
+    QCCTV_InfoPacket rungInfo = *info;
+    QCCTV_ImagePacket rungImage = *image;
+    rungInfo.resolution = QCCTV_Original;
+
+    /* Scale and encode each rung, starting with the highest resolution */
+    for (int i = rungs.count() - 1; i >= 0; --i) {
+        QCCTV_StreamRung* rung = rungs.at (i).data();
+        QCCTV_DeltaEncoder* delta = deltaFrames ? &rung->delta : Q_NULLPTR;
+
+        /* Skip the rungs that do not need this frame */
+        if (image->sequence % qMax (rung->divisor, 1) != 0)
+            continue;
+
+        /* Use the quality of the rung or the one of the rate controller */
+        rungInfo.quality = rung->quality > 0 ? rung->quality : info->quality;
+
+        if (rungImage.image.isNull())
+            rungImage.yuv = QCCTV_ScaleYUVImage (rungImage.yuv,
+                                                 rung->resolution);
+        else
+            rungImage.image = QCCTV_ScaleImage (rungImage.image,
+                                                rung->resolution);
+
+        rungImage.sequence = ++rung->sequence;
+        QByteArray data = QCCTV_CreateImagePacket (&rungImage, &rungInfo, delta);
+        QCCTV_SharedFrame frame (new QCCTV_EncodedFrame (rung->resolution,
+                                                         rungImage.sequence,
+                                                         rungImage.timestamp,
+                                                         data));
+        ladder.insert (rung->key, frame);
+    }
+
+    return ladder;
+}
+
+/**
+ * Returns \c true if the frame only contains the regions of the image that
+ * changed since the previous frame of its rung, in which case it cannot be
+ * decoded by a station that did not receive the previous frame
+ */
+bool QCCTV_EncodedFrame::isDelta() const
+{
+    QCCTV_FrameHeader header;
+    if (QCCTV_ReadFrameHeader (&header, m_data))
+        return header.flags & QCCTV_FRAME_DELTA;
+
+    return false;
+}
+
+/**
+ * Writes the header of an info or command packet of the given \a type to
+ * \a ptr. The header contains the size of the fixed fields, so that older
+ * readers can skip the fields appended by newer versions of the protocol.
+ *
+ * Returns a pointer to the first byte after the header
+ */
+static uchar* WritePacketHeader (uchar* ptr, const quint8 type,
+                                 const quint16 size)
+{
+    qToLittleEndian<quint32> (QCCTV_PACKET_MAGIC, ptr);
+    ptr[4] = QCCTV_PACKET_VERSION;
+    ptr[5] = type;
+    qToLittleEndian<quint16> (size, ptr + 6);
+
+    return ptr + QCCTV_PACKET_HEADER_SIZE;
+}
+
+/**
+ * Writes the given \a string as an extension with the given \a tag. Strings
+ * are stored as UTF-16LE and truncated to \c QCCTV_PACKET_MAX_STRING
+ * characters.
+ *
+ * Returns a pointer to the first byte after the extension, or \c NULL if
+ * the extension does not fit before \a end (or if \a ptr is \c NULL)
+ */
+static uchar* WriteStringExtension (uchar* ptr, const uchar* end,
+                                    const quint8 tag, const QString& string)
+{
+    if (!ptr)
+        return NULL;
+
+    /* Do not split surrogate pairs */
+    int length = qMin (string.length(), QCCTV_PACKET_MAX_STRING);
+    if (length < string.length() && string.at (length - 1).isHighSurrogate())
+        length -= 1;
+
+    if (end - ptr < 3 + length * 2)
+        return NULL;
+
+    ptr[0] = tag;
+    qToLittleEndian<quint16> (length * 2, ptr + 1);
+    ptr += 3;
+
+    const ushort* chars = string.utf16();
+    for (int i = 0; i < length; ++i, ptr += 2)
+        qToLittleEndian<quint16> (chars[i], ptr);
+
+    return ptr;
+}
+
+/**
+ * Writes the given \a bytes as an extension with the given \a tag. Each
+ * value is truncated to a single byte.
+ *
+ * Returns a pointer to the first byte after the extension, or \c NULL if
+ * the extension does not fit before \a end (or if \a ptr is \c NULL)
+ */
+static uchar* WriteByteExtension (uchar* ptr, const uchar* end,
+                                  const quint8 tag, const QList<int>& bytes)
+{
+    if (!ptr || end - ptr < 3 + bytes.count())
+        return NULL;
+
+    ptr[0] = tag;
+    qToLittleEndian<quint16> (bytes.count(), ptr + 1);
+    ptr += 3;
+
+    foreach (int value, bytes)
+        *ptr++ = value & 0xff;
+
+    return ptr;
+}
+
+/**
+ * Validates the header of the info or command packet of the given \a type
+ * stored in \a data, and obtains the \a offset of its first extension.
+ *
+ * This function shall return \c false if the packet is of a different type
+ * or version, or if it is too short to contain the fixed fields
+ */
+static bool ReadPacketHeader (const QByteArray& data, const quint8 type,
+                              const int size, int* offset)
+{
+    if (data.length() < QCCTV_PACKET_HEADER_SIZE)
+        return false;
+
+    const uchar* ptr = (const uchar*) data.constData();
+    if (qFromLittleEndian<quint32> (ptr) != QCCTV_PACKET_MAGIC ||
+        ptr[4] != QCCTV_PACKET_VERSION || ptr[5] != type)
+        return false;
+
+    const int fixed = qFromLittleEndian<quint16> (ptr + 6);
+    if (fixed < size || data.length() < QCCTV_PACKET_HEADER_SIZE + fixed)
+        return false;
+
+    *offset = QCCTV_PACKET_HEADER_SIZE + fixed;
+    return true;
+}
+
+/**
+ * Reads the extension located at the given \a offset of the \a data and
+ * moves the \a offset to the next extension.
+ *
+ * This function shall return \c false if the extension is truncated
  */
-void QCCTV_WriteImagePacket (QByteArray* output,
-                             const QCCTV_ImagePacket* image,
-                             const QCCTV_InfoPacket* info)
+static bool ReadExtension (const QByteArray& data, int* offset, quint8* tag,
+                           const uchar** value, int* length)
 {
-    output->clear();
-    *output = QCCTV_CreateImagePacket (image, info);
+    if (data.length() - *offset < 3)
+        return false;
+
+    const uchar* ptr = (const uchar*) data.constData() + *offset;
+    *tag = ptr[0];
+    *value = ptr + 3;
+    *length = qFromLittleEndian<quint16> (ptr + 1);
+
+    if (data.length() - *offset - 3 < *length)
+        return false;
+
+    *offset += 3 + *length;
+    return true;
+}
+
+/**
+ * Returns the UTF-16LE string stored in the given extension \a value
+ */
+static QString ReadStringExtension (const uchar* value, const int length)
+{
+    QString string (length / 2, Qt::Uninitialized);
+    QChar* chars = string.data();
+    for (int i = 0; i < string.length(); ++i)
+        chars[i] = QChar (qFromLittleEndian<quint16> (value + i * 2));
+
+    return string;
+}
+
+/**
+ * Writes the given stream \a packet to the given \a buffer, which can hold
+ * up to \a size bytes. This function does not allocate memory, use a buffer
+ * of \c QCCTV_PACKET_MAX_SIZE bytes to fit any packet.
+ *
+ * Returns the length of the packet, or \c -1 if it does not fit in the
+ * \a buffer
+ */
+int QCCTV_WriteInfoPacket (const QCCTV_InfoPacket* packet, char* buffer,
+                           const int size)
+{
+    if (!packet || !buffer || size < QCCTV_PACKET_HEADER_SIZE + INFO_SIZE)
+        return -1;
+
+    /* Write fixed fields */
+    uchar* ptr = WritePacketHeader ((uchar*) buffer, QCCTV_PACKET_INFO,
+                                    INFO_SIZE);
+    ptr[0] = packet->fps;
+    ptr[1] = packet->zoom;
+    ptr[2] = packet->codec;
+    ptr[3] = packet->quality;
+    ptr[4] = packet->supportedCodecs;
+    ptr[5] = (packet->supportsZoom ? INFO_ZOOM_AVAIL : 0) |
+             (packet->flashlightEnabled ? INFO_FLASHLIGHT : 0) |
+             (packet->autoRegulateResolution ? INFO_AUTOREGRES : 0);
+    qToLittleEndian<quint16> (packet->multicastPort, ptr + 6);
+    qToLittleEndian<qint32> (packet->bitrate, ptr + 8);
+    qToLittleEndian<qint32> (packet->resolution, ptr + 12);
+    qToLittleEndian<qint32> (packet->cameraStatus, ptr + 16);
+    qToLittleEndian<quint32> (packet->version, ptr + 20);
+    qToLittleEndian<quint32> (packet->commandAck, ptr + 24);
+    ptr[28] = packet->supportedChecksums;
+    ptr[29] = packet->checksum;
+    ptr[30] = 0;
+    ptr[31] = 0;
+    ptr += INFO_SIZE;
+
+    /* Write extensions */
+    const uchar* end = (const uchar*) buffer + size;
+    ptr = WriteStringExtension (ptr, end, TAG_NAME, packet->cameraName);
+    ptr = WriteStringExtension (ptr, end, TAG_GROUP, packet->cameraGroup);
+    if (!packet->multicastGroup.isEmpty())
+        ptr = WriteStringExtension (ptr, end, TAG_MCAST_ADDR,
+                                    packet->multicastGroup);
+
+    return ptr ? ptr - (uchar*) buffer : -1;
+}
+
+/**
+ * Writes the given command \a packet to the given \a buffer, which can hold
+ * up to \a size bytes. This function does not allocate memory, use a buffer
+ * of \c QCCTV_PACKET_MAX_SIZE bytes to fit any packet.
+ *
+ * Returns the length of the packet, or \c -1 if it does not fit in the
+ * \a buffer
+ */
+int QCCTV_WriteCommandPacket (const QCCTV_CommandPacket* packet, char* buffer,
+                              const int size)
+{
+    if (!packet || !buffer || size < QCCTV_PACKET_HEADER_SIZE + COMMAND_SIZE)
+        return -1;
+
+    /* Write fixed fields */
+    uchar* ptr = WritePacketHeader ((uchar*) buffer, QCCTV_PACKET_COMMAND,
+                                    COMMAND_SIZE);
+    ptr[0] = packet->fps;
+    ptr[1] = packet->zoom;
+    ptr[2] = packet->resolution;
+    ptr[3] = packet->quality;
+    ptr[4] = packet->capabilities;
+    ptr[5] = packet->supportedCodecs;
+    ptr[6] = (packet->keyframeRequest ? COMMAND_KEYFRAME_REQUEST : 0) |
+             (packet->flashlightEnabled ? COMMAND_FLASHLIGHT : 0) |
+             (packet->autoRegulateResolution ? COMMAND_AUTOREGRES : 0);
+    ptr[7] = packet->supportedChecksums;
+    qToLittleEndian<quint16> (packet->fields, ptr + 8);
+    qToLittleEndian<quint16> (packet->videoPort, ptr + 10);
+    qToLittleEndian<qint32> (packet->bitrate, ptr + 12);
+    qToLittleEndian<quint32> (packet->sequence, ptr + 16);
+    ptr += COMMAND_SIZE;
+
+    /* Write extensions */
+    const uchar* end = (const uchar*) buffer + size;
+    ptr = WriteStringExtension (ptr, end, TAG_HOST, packet->host);
+
+    return ptr ? ptr - (uchar*) buffer : -1;
+}
+
+/**
+ * Writes the given discovery \a packet to the given \a buffer, which can
+ * hold up to \a size bytes. This function does not allocate memory, use a
+ * buffer of \c QCCTV_PACKET_MAX_SIZE bytes to fit any packet.
+ *
+ * Returns the length of the packet, or \c -1 if it does not fit in the
+ * \a buffer
+ */
+int QCCTV_WriteAnnouncePacket (const QCCTV_AnnouncePacket* packet,
+                               char* buffer, const int size)
+{
+    if (!packet || !buffer || size < QCCTV_PACKET_HEADER_SIZE + ANNOUNCE_SIZE)
+        return -1;
+
+    /* Write fixed fields */
+    uchar* ptr = WritePacketHeader ((uchar*) buffer, QCCTV_PACKET_ANNOUNCE,
+                                    ANNOUNCE_SIZE);
+    qToLittleEndian<quint32> (packet->id, ptr);
+    qToLittleEndian<quint16> (packet->streamPort, ptr + 4);
+    qToLittleEndian<quint16> (packet->commandPort, ptr + 6);
+    ptr[8] = packet->fps;
+    ptr[9] = packet->codec;
+    ptr[10] = packet->resolution;
+    ptr[11] = packet->supportedCodecs;
+    ptr[12] = packet->supportedChecksums;
+    ptr[13] = 0;
+    ptr[14] = 0;
+    ptr[15] = 0;
+    ptr += ANNOUNCE_SIZE;
+
+    /* Write extensions */
+    const uchar* end = (const uchar*) buffer + size;
+    ptr = WriteStringExtension (ptr, end, TAG_NAME, packet->cameraName);
+    ptr = WriteStringExtension (ptr, end, TAG_GROUP, packet->cameraGroup);
+    ptr = WriteByteExtension (ptr, end, TAG_RUNGS, packet->rungs);
+
+    return ptr ? ptr - (uchar*) buffer : -1;
+}
+
+/**
+ * Generates the probe that stations broadcast to ask every camera in the
+ * local network to announce itself
+ */
+QByteArray QCCTV_CreateProbePacket()
+{
+    char buffer [QCCTV_PACKET_HEADER_SIZE];
+    WritePacketHeader ((uchar*) buffer, QCCTV_PACKET_PROBE, PROBE_SIZE);
+    return QByteArray (buffer, sizeof (buffer));
 }
 
 /**
@@ -124,17 +537,77 @@ void QCCTV_WriteImagePacket (QByteArray* output,
  */
 QByteArray QCCTV_CreateInfoPacket (const QCCTV_InfoPacket* packet)
 {
-    QJsonObject json;
-    json.insert (KEY_FPS, packet->fps);
-    json.insert (KEY_ZOOM, packet->zoom);
-    json.insert (KEY_NAME, packet->cameraName);
-    json.insert (KEY_GROUP, packet->cameraGroup);
-    json.insert (KEY_STATUS, packet->cameraStatus);
-    json.insert (KEY_RESOLUTION, packet->resolution);
-    json.insert (KEY_ZOOM_AVAIL, packet->supportsZoom);
-    json.insert (KEY_FLASHLIGHT, packet->flashlightEnabled);
-    json.insert (KEY_AUTOREGRES, packet->autoRegulateResolution);
-    return QJsonDocument (json).toBinaryData();
+    char buffer [QCCTV_PACKET_MAX_SIZE];
+    const int length = QCCTV_WriteInfoPacket (packet, buffer, sizeof (buffer));
+    if (length > 0)
+        return QByteArray (buffer, length);
+
+    return QByteArray();
+}
+
+/**
+ * Serializes the given frame \a header in network byte order. The unused
+ * bytes of the header are reserved for future use and are always zero, so
+ * older cameras always report the CRC32 algorithm
+ */
+QByteArray QCCTV_CreateFrameHeader (const QCCTV_FrameHeader* header)
+{
+    QByteArray data (QCCTV_FRAME_HEADER_SIZE, 0);
+    uchar* ptr = (uchar*) data.data();
+
+    qToBigEndian<quint32> (header->magic, ptr);
+    ptr[4] = header->version;
+    ptr[5] = header->flags;
+    ptr[6] = header->codec;
+    ptr[7] = header->channel;
+    ptr[8] = header->algorithm;
+    qToBigEndian<quint32> (header->sequence, ptr + 12);
+    qToBigEndian<quint32> (header->length, ptr + 16);
+    qToBigEndian<quint32> (header->checksum, ptr + 20);
+
+    return data;
+}
+
+/**
+ * Reads the given discovery \a packet and generates the binary data that
+ * cameras send to announce themselves to the stations
+ */
+QByteArray QCCTV_CreateAnnouncePacket (const QCCTV_AnnouncePacket* packet)
+{
+    char buffer [QCCTV_PACKET_MAX_SIZE];
+    const int length = QCCTV_WriteAnnouncePacket (packet, buffer,
+                                                  sizeof (buffer));
+    if (length > 0)
+        return QByteArray (buffer, length);
+
+    return QByteArray();
+}
+
+/**
+ * Puts a frame header before the given info or command packet \a data, so
+ * that it can be sent through the stream connection in the given \a channel
+ */
+QByteArray QCCTV_CreateChannelPacket (const quint8 channel, const char* data,
+                                      const int length)
+{
+    QByteArray payload = QByteArray::fromRawData (data, length);
+
+    QCCTV_FrameHeader header;
+    header.magic = QCCTV_FRAME_MAGIC;
+    header.version = QCCTV_FRAME_VERSION;
+    header.flags = 0;
+    header.codec = 0;
+    header.channel = channel;
+    header.algorithm = QCCTV_CHECKSUM_CRC32;
+    header.sequence = 0;
+    header.length = length;
+    header.checksum = QCCTV_Checksum::compute (header.algorithm, data, length);
+
+    QByteArray frame;
+    frame.reserve (QCCTV_FRAME_HEADER_SIZE + length);
+    frame.append (QCCTV_CreateFrameHeader (&header));
+    frame.append (payload);
+    return frame;
 }
 
 /**
@@ -143,42 +616,271 @@ QByteArray QCCTV_CreateInfoPacket (const QCCTV_InfoPacket* packet)
  */
 QByteArray QCCTV_CreateCommandPacket (const QCCTV_CommandPacket* packet)
 {
-    QJsonObject json;
-    json.insert (KEY_HOST, packet->host);
-    json.insert (KEY_OLD_FPS, packet->oldFps);
-    json.insert (KEY_NEW_FPS, packet->newFps);
-    json.insert (KEY_OLD_ZOOM, packet->oldZoom);
-    json.insert (KEY_NEW_ZOOM, packet->newZoom);
-    json.insert (KEY_FOCUS_REQUEST, packet->focusRequest);
-    json.insert (KEY_OLD_RESOLUTION, packet->oldResolution);
-    json.insert (KEY_NEW_RESOLUTION, packet->newResolution);
-    json.insert (KEY_OLD_FLASHLIGHT, packet->oldFlashlightEnabled);
-    json.insert (KEY_NEW_FLASHLIGHT, packet->newFlashlightEnabled);
-    json.insert (KEY_OLD_AUTOREGRES, packet->oldAutoRegulateResolution);
-    json.insert (KEY_NEW_AUTOREGRES, packet->newAutoRegulateResolution);
-    return QJsonDocument (json).toBinaryData();
+    char buffer [QCCTV_PACKET_MAX_SIZE];
+    const int length = QCCTV_WriteCommandPacket (packet, buffer,
+                                                 sizeof (buffer));
+    if (length > 0)
+        return QByteArray (buffer, length);
+
+    return QByteArray();
 }
 
 /**
  * Reads the given image \a packet and \a info packet and generates a
- * binary image and its respective CRC32 bits
+ * frame that consists of a fixed-size header (with the length and checksum
+ * of the payload) followed by the image encoded with the codec and checksum
+ * algorithm specified by the \a info packet.
+ *
+ * If a \a delta encoder is given and the codec is JPEG, the frame shall only
+ * contain the regions of the image that changed since the last keyframe.
+ *
+ * If the packet only contains a YUV image, JPEG keyframes are encoded
+ * directly from the YUV planes, the YUV image is converted to RGB only when
+ * it is needed by the delta encoder or by the other codecs
  */
 QByteArray QCCTV_CreateImagePacket (const QCCTV_ImagePacket* packet,
-                                    const QCCTV_InfoPacket* info)
+                                    const QCCTV_InfoPacket* info,
+                                    QCCTV_DeltaEncoder* delta)
 {
-    /* Add image data */
-    QByteArray data = QCCTV_EncodeImage (packet->image, info->resolution);
-    QByteArray comp = qCompress (data, 9);
+    QByteArray comp;
+    QImage image = packet->image;
+    quint8 codec = info->codec;
+    quint8 flags = packet->flags;
+    int resolution = info->resolution;
+
+    bool encoded = false;
+    bool deltaFrame = delta && info->codec == QCCTV_CODEC_JPEG;
+
+    /* Encode complete JPEG frames directly from the YUV image */
+    if (image.isNull() && !packet->yuv.isNull()) {
+        if (!deltaFrame && info->codec != QCCTV_CODEC_LZ4) {
+            comp = QCCTV_EncodeYUVImage (packet->yuv,
+                                         resolution,
+                                         info->quality);
+
+            if (info->codec == QCCTV_CODEC_ZLIB)
+                comp = qCompress (comp, 1);
+
+            encoded = true;
+        }
+
+        else {
+            image = QCCTV_YUVToImage (QCCTV_ScaleYUVImage (packet->yuv,
+                                                           resolution));
+            resolution = QCCTV_Original;
+        }
+    }
 
-    /* Add the cheksum at the start of the data */
-    quint32 crc = crc32.compute (comp);
-    comp.prepend ((crc & 0xff));
-    comp.prepend ((crc & 0xff00) >> 8);
-    comp.prepend ((crc & 0xff0000) >> 16);
-    comp.prepend ((crc & 0xff000000) >> 24);
+    /* Try to generate a delta frame (keyframes re-use the scaled image) */
+    if (deltaFrame) {
+        image = QCCTV_ScaleImage (image, resolution);
+        resolution = QCCTV_Original;
+
+        encoded = delta->encode (image, info->quality, &comp);
+        flags |= encoded ? QCCTV_FRAME_DELTA : QCCTV_FRAME_KEYFRAME;
+    }
+
+    /* Encode the whole image */
+    if (!encoded) {
+        switch (info->codec) {
+        case QCCTV_CODEC_ZLIB:
+            comp = qCompress (QCCTV_EncodeImage (image,
+                                                 resolution,
+                                                 info->quality), 1);
+            break;
+        case QCCTV_CODEC_LZ4:
+            comp = QCCTV_EncodeRawImage (image, resolution);
+            if (comp.isEmpty()) {
+                codec = QCCTV_CODEC_JPEG;
+                comp = QCCTV_EncodeImage (image, resolution, info->quality);
+            }
+            break;
+        default:
+            comp = QCCTV_EncodeImage (image, resolution, info->quality);
+            break;
+        }
+    }
+
+    /* Fill the frame header */
+    QCCTV_FrameHeader header;
+    header.magic = QCCTV_FRAME_MAGIC;
+    header.version = QCCTV_FRAME_VERSION;
+    header.flags = flags;
+    header.codec = codec;
+    header.channel = QCCTV_CHANNEL_VIDEO;
+    header.algorithm = info->checksum;
+    header.sequence = packet->sequence;
+    header.length = comp.length();
+    header.checksum = QCCTV_Checksum::compute (header.algorithm,
+                                               comp.constData(),
+                                               comp.length());
+
+    /* Put the header before the payload */
+    QByteArray frame;
+    frame.reserve (QCCTV_FRAME_HEADER_SIZE + comp.length());
+    frame.append (QCCTV_CreateFrameHeader (&header));
+    frame.append (comp);
 
     /* Return obtained data */
-    return comp;
+    return frame;
+}
+
+/**
+ * Splits the given (complete) \a frame into UDP datagrams that fit in the
+ * MTU of most networks. Each datagram starts with a 12-byte header:
+ *
+ * - Magic number (4 bytes)
+ * - The given frame \a id (4 bytes)
+ * - Index of the fragment in the frame (2 bytes)
+ * - Number of fragments of the frame (2 bytes)
+ *
+ * All values are big-endian, like in the frame header
+ */
+QList<QByteArray> QCCTV_CreateDatagrams (const QByteArray& frame,
+                                         const quint32 id)
+{
+    QList<QByteArray> datagrams;
+    const int payload = QCCTV_DATAGRAM_SIZE - QCCTV_DATAGRAM_HEADER_SIZE;
+    const int count = (frame.size() + payload - 1) / payload;
+
+    if (count <= 0 || count > 0xffff)
+        return datagrams;
+
+    for (int i = 0; i < count; ++i) {
+        const int offset = i * payload;
+        const int length = qMin (payload, frame.size() - offset);
+
+        QByteArray datagram (QCCTV_DATAGRAM_HEADER_SIZE + length, 0);
+        uchar* ptr = (uchar*) datagram.data();
+        qToBigEndian<quint32> (QCCTV_DATAGRAM_MAGIC, ptr);
+        qToBigEndian<quint32> (id, ptr + 4);
+        qToBigEndian<quint16> (i, ptr + 8);
+        qToBigEndian<quint16> (count, ptr + 10);
+        memcpy (ptr + QCCTV_DATAGRAM_HEADER_SIZE,
+                frame.constData() + offset, length);
+
+        datagrams.append (datagram);
+    }
+
+    return datagrams;
+}
+
+/**
+ * Returns the position of the first frame header found in the given \a data
+ * after the \a from index, or \c -1 if there is no header in the data.
+ *
+ * This function is used by the stations to re-synchronize the stream after
+ * receiving a corrupted frame
+ */
+int QCCTV_FindFrameHeader (const QByteArray& data, const int from)
+{
+    uchar magic [4];
+    qToBigEndian<quint32> (QCCTV_FRAME_MAGIC, magic);
+    return data.indexOf (QByteArray ((char*) magic, 4), from);
+}
+
+/**
+ * Reads the header of the given UDP \a data and copies its payload to the
+ * given \a datagram. Returns \c false if the datagram is not valid
+ */
+bool QCCTV_ReadDatagram (QCCTV_Datagram* datagram, const QByteArray& data)
+{
+    if (!datagram || data.length() <= QCCTV_DATAGRAM_HEADER_SIZE)
+        return false;
+
+    const uchar* ptr = (const uchar*) data.constData();
+    if (qFromBigEndian<quint32> (ptr) != QCCTV_DATAGRAM_MAGIC)
+        return false;
+
+    datagram->frame = qFromBigEndian<quint32> (ptr + 4);
+    datagram->index = qFromBigEndian<quint16> (ptr + 8);
+    datagram->count = qFromBigEndian<quint16> (ptr + 10);
+    datagram->payload = data.mid (QCCTV_DATAGRAM_HEADER_SIZE);
+
+    return datagram->count > 0 && datagram->index < datagram->count;
+}
+
+/**
+ * Obtains the info or command packet \a payload from the given frame
+ * \a data, which must contain a complete frame.
+ *
+ * This function shall return \c false if the frame is incomplete or if the
+ * checksums do not match
+ */
+bool QCCTV_ReadChannelPacket (QByteArray* payload, const QByteArray& data)
+{
+    QCCTV_FrameHeader header;
+    if (!payload || !QCCTV_ReadFrameHeader (&header, data))
+        return false;
+
+    if ((quint32) data.length() < QCCTV_FRAME_HEADER_SIZE + header.length)
+        return false;
+
+    *payload = data.mid (QCCTV_FRAME_HEADER_SIZE, header.length);
+    return QCCTV_Checksum::compute (header.algorithm, payload->constData(),
+                                    payload->length()) == header.checksum;
+}
+
+/**
+ * Reads the frame header located at the start of the given \a data.
+ *
+ * This function shall return \c false if there is not enough data to read
+ * the header or if the header is not valid (e.g. wrong magic number, wrong
+ * version, unknown checksum algorithm or a payload length that we are not
+ * willing to buffer)
+ */
+bool QCCTV_ReadFrameHeader (QCCTV_FrameHeader* header, const QByteArray& data)
+{
+    return QCCTV_ReadFrameHeader (header, data.constData(), data.length());
+}
+
+/**
+ * Reads the frame header located at the start of the given \a data, which
+ * contains \a length bytes
+ */
+bool QCCTV_ReadFrameHeader (QCCTV_FrameHeader* header, const char* data,
+                            const int length)
+{
+    if (!header || !data || length < QCCTV_FRAME_HEADER_SIZE)
+        return false;
+
+    /* Read header fields */
+    const uchar* ptr = (const uchar*) data;
+    header->magic = qFromBigEndian<quint32> (ptr);
+    header->version = ptr[4];
+    header->flags = ptr[5];
+    header->codec = ptr[6];
+    header->channel = ptr[7];
+    header->algorithm = ptr[8];
+    header->sequence = qFromBigEndian<quint32> (ptr + 12);
+    header->length = qFromBigEndian<quint32> (ptr + 16);
+    header->checksum = qFromBigEndian<quint32> (ptr + 20);
+
+    /* Validate header */
+    return header->magic == QCCTV_FRAME_MAGIC &&
+           header->version == QCCTV_FRAME_VERSION &&
+           header->length <= QCCTV_MAX_BUFFER_SIZE &&
+           QCCTV_Checksum::isSupported (header->algorithm);
+}
+
+/**
+ * Obtains the \a version of the camera information stored in the given info
+ * packet \a data without parsing the rest of the packet. The camera changes
+ * the version every time that the information changes, so that stations can
+ * skip the packets that do not contain anything new.
+ *
+ * This function shall return \c true on success, \c false on failure
+ */
+bool QCCTV_ReadInfoVersion (quint32* version, const QByteArray& data)
+{
+    int offset = 0;
+    if (!version || !ReadPacketHeader (data, QCCTV_PACKET_INFO,
+                                       INFO_SIZE_CRC32, &offset))
+        return false;
+
+    const uchar* ptr = (const uchar*) data.constData();
+    *version = qFromLittleEndian<quint32> (ptr + QCCTV_PACKET_HEADER_SIZE + 20);
+    return true;
 }
 
 /**
@@ -190,55 +892,122 @@ QByteArray QCCTV_CreateImagePacket (const QCCTV_ImagePacket* packet,
 bool QCCTV_ReadInfoPacket (QCCTV_InfoPacket* packet, const QByteArray& data)
 {
     /* Packet pointer is invalid and/or data incomplete */
-    if (!packet || data.isEmpty())
+    int offset = 0;
+    if (!packet || !ReadPacketHeader (data, QCCTV_PACKET_INFO,
+                                      INFO_SIZE_CRC32, &offset))
         return false;
 
-    /* Get JSON object from data */
-    QJsonObject json = QJsonDocument::fromBinaryData (data).object();
-    if (json.isEmpty())
-        return false;
+    /* Read fixed fields */
+    QCCTV_InfoPacket info;
+    const uchar* ptr = (const uchar*) data.constData() +
+                       QCCTV_PACKET_HEADER_SIZE;
+    info.fps = ptr[0];
+    info.zoom = ptr[1];
+    info.codec = ptr[2];
+    info.quality = ptr[3];
+    info.supportedCodecs = ptr[4];
+    info.supportsZoom = ptr[5] & INFO_ZOOM_AVAIL;
+    info.flashlightEnabled = ptr[5] & INFO_FLASHLIGHT;
+    info.autoRegulateResolution = ptr[5] & INFO_AUTOREGRES;
+    info.multicastPort = qFromLittleEndian<quint16> (ptr + 6);
+    info.bitrate = qFromLittleEndian<qint32> (ptr + 8);
+    info.resolution = qFromLittleEndian<qint32> (ptr + 12);
+    info.cameraStatus = qFromLittleEndian<qint32> (ptr + 16);
+    info.version = qFromLittleEndian<quint32> (ptr + 20);
+    info.commandAck = qFromLittleEndian<quint32> (ptr + 24);
+
+    /* Older cameras only support CRC32 */
+    info.checksum = QCCTV_CHECKSUM_CRC32;
+    info.supportedChecksums = 1 << QCCTV_CHECKSUM_CRC32;
+    if (offset - QCCTV_PACKET_HEADER_SIZE >= INFO_SIZE) {
+        info.supportedChecksums = ptr[28];
+        info.checksum = ptr[29];
+    }
 
-    /* Get information from JSON object */
-    packet->fps = json.value (KEY_FPS).toInt();
-    packet->zoom = json.value (KEY_ZOOM).toInt();
-    packet->cameraName = json.value (KEY_NAME).toString();
-    packet->cameraStatus = json.value (KEY_STATUS).toInt();
-    packet->cameraGroup = json.value (KEY_GROUP).toString();
-    packet->resolution = json.value (KEY_RESOLUTION).toInt();
-    packet->supportsZoom = json.value (KEY_ZOOM_AVAIL).toBool();
-    packet->flashlightEnabled = json.value (KEY_FLASHLIGHT).toBool();
-    packet->autoRegulateResolution = json.value (KEY_AUTOREGRES).toBool();
+    /* Read extensions (and skip unknown extensions) */
+    quint8 tag;
+    int length;
+    const uchar* value;
+    while (offset < data.length()) {
+        if (!ReadExtension (data, &offset, &tag, &value, &length))
+            return false;
+
+        if (tag == TAG_NAME)
+            info.cameraName = ReadStringExtension (value, length);
+        else if (tag == TAG_GROUP)
+            info.cameraGroup = ReadStringExtension (value, length);
+        else if (tag == TAG_MCAST_ADDR)
+            info.multicastGroup = ReadStringExtension (value, length);
+    }
 
     /* Packet read successfully */
+    *packet = info;
     return true;
 }
 
 /**
- * Obtains the image from the given \a data (only if CRC32 codes match)
+ * Obtains the image from the given frame \a data (only if checksums match).
+ *
+ * The \a data must contain a complete frame (header and payload), use
+ * \c QCCTV_ReadFrameHeader() to know how many bytes to wait for.
+ *
+ * If the frame is a delta frame, the changed regions are drawn over the
+ * current image of the \a packet, which must be the image obtained from
+ * the previous frame.
+ *
+ * Set \a verified to \c true if the caller already checksummed the payload
+ * while it was being received, so that it is not read twice
  */
-bool QCCTV_ReadImagePacket (QCCTV_ImagePacket* packet, const QByteArray& data)
+bool QCCTV_ReadImagePacket (QCCTV_ImagePacket* packet, const QByteArray& data,
+                            const bool verified)
 {
-    if (!packet || data.length() < 4)
+    /* Read the frame header */
+    QCCTV_FrameHeader header;
+    if (!packet || !QCCTV_ReadFrameHeader (&header, data))
         return false;
 
-    /* Get the checksum */
-    quint8 a = data.at (0);
-    quint8 b = data.at (1);
-    quint8 c = data.at (2);
-    quint8 d = data.at (3);
-    packet->crc32 = (a << 24) | (b << 16) | (c << 8) | (d & 0xff);
+    /* Frame is incomplete */
+    const int length = QCCTV_FRAME_HEADER_SIZE + header.length;
+    if (data.length() < length)
+        return false;
 
-    /* Create byte array without checksum header */
-    QByteArray stream = data;
-    stream.remove (0, 4);
+    /* Get the payload (without copying it) */
+    QByteArray stream = QByteArray::fromRawData (data.constData() +
+                                                 QCCTV_FRAME_HEADER_SIZE,
+                                                 header.length);
 
     /* Compare checksums (abort if they are different) */
-    quint32 crc = crc32.compute (stream);
-    if (packet->crc32 != crc)
+    packet->codec = header.codec;
+    packet->flags = header.flags;
+    packet->crc32 = header.checksum;
+    packet->sequence = header.sequence;
+    if (!verified) {
+        const quint32 checksum = QCCTV_Checksum::compute (header.algorithm,
+                                                          stream.constData(),
+                                                          stream.length());
+        if (packet->crc32 != checksum)
+            return false;
+    }
+
+    /* Draw the changed regions over the previous image */
+    if (packet->flags & QCCTV_FRAME_DELTA)
+        return QCCTV_ApplyDeltaFrame (&packet->image, stream);
+
+    /* Read image using the codec specified by the header */
+    switch (packet->codec) {
+    case QCCTV_CODEC_ZLIB:
+        packet->image = QCCTV_DecodeImage (qUncompress (stream));
+        break;
+    case QCCTV_CODEC_JPEG:
+        packet->image = QCCTV_DecodeImage (stream);
+        break;
+    case QCCTV_CODEC_LZ4:
+        packet->image = QCCTV_DecodeRawImage (stream);
+        break;
+    default:
         return false;
+    }
 
-    /* Read image */
-    packet->image = QCCTV_DecodeImage (qUncompress (stream));
     return !packet->image.isNull();
 }
 
@@ -252,36 +1021,184 @@ bool QCCTV_ReadCommandPacket (QCCTV_CommandPacket* packet,
                               const QByteArray& data)
 {
     /* Packet pointer is invalid and/or data incomplete */
-    if (!packet || data.isEmpty())
+    int offset = 0;
+    if (!packet || !ReadPacketHeader (data, QCCTV_PACKET_COMMAND,
+                                      COMMAND_SIZE, &offset))
         return false;
 
-    /* Get JSON object from data */
-    QJsonObject json = QJsonDocument::fromBinaryData (data).object();
-    if (json.isEmpty())
+    /* Read extensions (and skip unknown extensions) */
+    quint8 tag;
+    int length;
+    QString host;
+    const uchar* value;
+    while (offset < data.length()) {
+        if (!ReadExtension (data, &offset, &tag, &value, &length))
+            return false;
+
+        if (tag == TAG_HOST)
+            host = ReadStringExtension (value, length);
+    }
+
+    /* Read fixed fields */
+    const uchar* ptr = (const uchar*) data.constData() +
+                       QCCTV_PACKET_HEADER_SIZE;
+    packet->host = host;
+    packet->fps = ptr[0];
+    packet->zoom = ptr[1];
+    packet->resolution = ptr[2];
+    packet->quality = ptr[3];
+    packet->capabilities = ptr[4];
+    packet->supportedCodecs = ptr[5];
+    packet->supportedChecksums = ptr[7];
+    packet->keyframeRequest = ptr[6] & COMMAND_KEYFRAME_REQUEST;
+    packet->flashlightEnabled = ptr[6] & COMMAND_FLASHLIGHT;
+    packet->autoRegulateResolution = ptr[6] & COMMAND_AUTOREGRES;
+    packet->fields = qFromLittleEndian<quint16> (ptr + 8);
+    packet->videoPort = qFromLittleEndian<quint16> (ptr + 10);
+    packet->bitrate = qFromLittleEndian<qint32> (ptr + 12);
+    packet->sequence = qFromLittleEndian<quint32> (ptr + 16);
+
+    /* Packet read successfully */
+    return true;
+}
+
+/**
+ * Reads the given \a binary data and updates the values of the given
+ * discovery \a packet structure
+ *
+ * This function shall return \c true on success, \c false on failure
+ */
+bool QCCTV_ReadAnnouncePacket (QCCTV_AnnouncePacket* packet,
+                               const QByteArray& data)
+{
+    /* Packet pointer is invalid and/or data incomplete */
+    int offset = 0;
+    if (!packet || !ReadPacketHeader (data, QCCTV_PACKET_ANNOUNCE,
+                                      ANNOUNCE_SIZE, &offset))
         return false;
 
-    /* Get information from JSON object */
-    packet->host = json.value (KEY_HOST).toString();
-    packet->oldFps = json.value (KEY_OLD_FPS).toInt();
-    packet->newFps = json.value (KEY_NEW_FPS).toInt();
-    packet->oldZoom = json.value (KEY_OLD_ZOOM).toInt();
-    packet->newZoom = json.value (KEY_NEW_ZOOM).toInt();
-    packet->focusRequest = json.value (KEY_FOCUS_REQUEST).toBool();
-    packet->oldResolution = json.value (KEY_OLD_RESOLUTION).toInt();
-    packet->newResolution = json.value (KEY_NEW_RESOLUTION).toInt();
-    packet->oldFlashlightEnabled = json.value (KEY_OLD_FLASHLIGHT).toBool();
-    packet->newFlashlightEnabled = json.value (KEY_NEW_FLASHLIGHT).toBool();
-    packet->oldAutoRegulateResolution = json.value (KEY_OLD_AUTOREGRES).toBool();
-    packet->newAutoRegulateResolution = json.value (KEY_NEW_AUTOREGRES).toBool();
-
-    /* Check command flags have changed since last packet */
-    packet->fpsChanged = (packet->oldFps != packet->newFps);
-    packet->zoomChanged = (packet->oldZoom != packet->newZoom);
-    packet->resolutionChanged = (packet->oldResolution != packet->newResolution);
-    packet->flashlightEnabledChanged = (packet->oldFlashlightEnabled != packet->newFlashlightEnabled);
-    packet->autoRegulateResolutionChanged = (packet->oldAutoRegulateResolution !=
-                                             packet->newAutoRegulateResolution);
+    /* Read fixed fields */
+    QCCTV_AnnouncePacket announce;
+    const uchar* ptr = (const uchar*) data.constData() +
+                       QCCTV_PACKET_HEADER_SIZE;
+    announce.id = qFromLittleEndian<quint32> (ptr);
+    announce.streamPort = qFromLittleEndian<quint16> (ptr + 4);
+    announce.commandPort = qFromLittleEndian<quint16> (ptr + 6);
+    announce.fps = ptr[8];
+    announce.codec = ptr[9];
+    announce.resolution = ptr[10];
+    announce.supportedCodecs = ptr[11];
+    announce.supportedChecksums = ptr[12];
+
+    /* Read extensions (and skip unknown extensions) */
+    quint8 tag;
+    int length;
+    const uchar* value;
+    while (offset < data.length()) {
+        if (!ReadExtension (data, &offset, &tag, &value, &length))
+            return false;
+
+        if (tag == TAG_NAME)
+            announce.cameraName = ReadStringExtension (value, length);
+        else if (tag == TAG_GROUP)
+            announce.cameraGroup = ReadStringExtension (value, length);
+        else if (tag == TAG_RUNGS) {
+            for (int i = 0; i < length; ++i)
+                announce.rungs.append (value[i]);
+        }
+    }
 
     /* Packet read successfully */
+    *packet = announce;
     return true;
 }
+
+/**
+ * Returns \c true if the given \a data is a probe sent by a station
+ */
+bool QCCTV_ReadProbePacket (const QByteArray& data)
+{
+    int offset = 0;
+    return ReadPacketHeader (data, QCCTV_PACKET_PROBE, PROBE_SIZE, &offset);
+}
+
+/**
+ * Returns a JSON representation of the given info, command or discovery
+ * packet \a data, which is useful to debug the communications between
+ * cameras and stations.
+ *
+ * An empty object is returned if the \a data is not a valid packet
+ */
+QJsonObject QCCTV_DumpPacket (const QByteArray& data)
+{
+    QJsonObject json;
+    QCCTV_InfoPacket info;
+    QCCTV_CommandPacket command;
+    QCCTV_AnnouncePacket announce;
+
+    if (QCCTV_ReadInfoPacket (&info, data)) {
+        json.insert (KEY_TYPE, QString ("info"));
+        json.insert (KEY_VERSION, (qint64) info.version);
+        json.insert (KEY_FPS, info.fps);
+        json.insert (KEY_ZOOM, info.zoom);
+        json.insert (KEY_CODEC, info.codec);
+        json.insert (KEY_CODECS, info.supportedCodecs);
+        json.insert (KEY_QUALITY, info.quality);
+        json.insert (KEY_BITRATE, info.bitrate);
+        json.insert (KEY_NAME, info.cameraName);
+        json.insert (KEY_GROUP, info.cameraGroup);
+        json.insert (KEY_STATUS, info.cameraStatus);
+        json.insert (KEY_RESOLUTION, info.resolution);
+        json.insert (KEY_ZOOM_AVAIL, info.supportsZoom);
+        json.insert (KEY_FLASHLIGHT, info.flashlightEnabled);
+        json.insert (KEY_AUTOREGRES, info.autoRegulateResolution);
+        json.insert (KEY_MCAST_PORT, info.multicastPort);
+        json.insert (KEY_MCAST_ADDR, info.multicastGroup);
+        json.insert (KEY_CMD_ACK, (qint64) info.commandAck);
+        json.insert (KEY_CHECKSUM, info.checksum);
+        json.insert (KEY_CHECKSUMS, info.supportedChecksums);
+    }
+
+    else if (QCCTV_ReadCommandPacket (&command, data)) {
+        json.insert (KEY_TYPE, QString ("command"));
+        json.insert (KEY_HOST, command.host);
+        json.insert (KEY_SEQUENCE, (qint64) command.sequence);
+        json.insert (KEY_FIELDS, command.fields);
+        json.insert (KEY_FPS, command.fps);
+        json.insert (KEY_ZOOM, command.zoom);
+        json.insert (KEY_BITRATE, command.bitrate);
+        json.insert (KEY_CODECS, command.supportedCodecs);
+        json.insert (KEY_CHECKSUMS, command.supportedChecksums);
+        json.insert (KEY_CAPABILITIES, command.capabilities);
+        json.insert (KEY_QUALITY, command.quality);
+        json.insert (KEY_KEYFRAME_REQUEST, command.keyframeRequest);
+        json.insert (KEY_VIDEO_PORT, command.videoPort);
+        json.insert (KEY_RESOLUTION, command.resolution);
+        json.insert (KEY_FLASHLIGHT, command.flashlightEnabled);
+        json.insert (KEY_AUTOREGRES, command.autoRegulateResolution);
+    }
+
+    else if (QCCTV_ReadAnnouncePacket (&announce, data)) {
+        QJsonArray rungs;
+        foreach (int rung, announce.rungs)
+            rungs.append (rung);
+
+        json.insert (KEY_TYPE, QString ("announce"));
+        json.insert (KEY_ID, (qint64) announce.id);
+        json.insert (KEY_STREAM_PORT, announce.streamPort);
+        json.insert (KEY_COMMAND_PORT, announce.commandPort);
+        json.insert (KEY_FPS, announce.fps);
+        json.insert (KEY_CODEC, announce.codec);
+        json.insert (KEY_CODECS, announce.supportedCodecs);
+        json.insert (KEY_CHECKSUMS, announce.supportedChecksums);
+        json.insert (KEY_RESOLUTION, announce.resolution);
+        json.insert (KEY_RUNGS, rungs);
+        json.insert (KEY_NAME, announce.cameraName);
+        json.insert (KEY_GROUP, announce.cameraGroup);
+    }
+
+    else if (QCCTV_ReadProbePacket (data))
+        json.insert (KEY_TYPE, QString ("probe"));
+
+    return json;
+}
@@ -24,43 +24,152 @@
 #define _QCCTV_COMMUNICATIONS_H
 
 #include "QCCTV.h"
+#include "QCCTV_DeltaEncoder.h"
+
+#include <QMap>
+#include <QList>
+#include <QJsonObject>
+#include <QSharedPointer>
 
 struct QCCTV_InfoPacket {
     quint8 fps;
     quint8 zoom;
+    quint8 codec;
+    quint8 quality;
+    quint8 supportedCodecs;
+    quint8 checksum;
+    quint8 supportedChecksums;
+    quint32 version;
+    quint32 commandAck;
+    int bitrate;
     int resolution;
     int cameraStatus;
     bool supportsZoom;
+    quint16 multicastPort;
+    QString multicastGroup;
     QString cameraName;
     QString cameraGroup;
     bool flashlightEnabled;
     bool autoRegulateResolution;
 };
 
+struct QCCTV_AnnouncePacket {
+    quint32 id;
+    quint16 streamPort;
+    quint16 commandPort;
+    quint8 fps;
+    quint8 codec;
+    quint8 resolution;
+    quint8 supportedCodecs;
+    quint8 supportedChecksums;
+    QList<int> rungs;
+    QString cameraName;
+    QString cameraGroup;
+};
+
+struct QCCTV_FrameHeader {
+    quint32 magic;
+    quint8 version;
+    quint8 flags;
+    quint8 codec;
+    quint8 channel;
+    quint8 algorithm;
+    quint32 sequence;
+    quint32 length;
+    quint32 checksum;
+};
+
+struct QCCTV_Datagram {
+    quint32 frame;
+    quint16 index;
+    quint16 count;
+    QByteArray payload;
+};
+
 struct QCCTV_ImagePacket {
     QImage image;
+    QCCTV_YUVImage yuv;
     quint32 crc32;
+    quint8 codec;
+    quint8 flags;
+    quint32 sequence;
+    qint64 timestamp;
 };
 
 struct QCCTV_CommandPacket {
     QString host;
-    quint8 oldFps;
-    quint8 newFps;
-    quint8 oldZoom;
-    quint8 newZoom;
-    bool focusRequest;
-    quint8 oldResolution;
-    quint8 newResolution;
-    bool oldFlashlightEnabled;
-    bool newFlashlightEnabled;
-    bool oldAutoRegulateResolution;
-    bool newAutoRegulateResolution;
-
-    bool fpsChanged;
-    bool zoomChanged;
-    bool resolutionChanged;
-    bool flashlightEnabledChanged;
-    bool autoRegulateResolutionChanged;
+    quint32 sequence;
+    quint16 fields;
+    quint8 fps;
+    quint8 zoom;
+    int bitrate;
+    quint8 resolution;
+    bool flashlightEnabled;
+    bool autoRegulateResolution;
+    quint8 quality;
+    quint16 videoPort;
+    quint8 capabilities;
+    bool keyframeRequest;
+    quint8 supportedCodecs;
+    quint8 supportedChecksums;
+};
+
+/**
+ * \brief Immutable image packet shared by every socket that sends it
+ *
+ * Encoded frames are created once by the encoder thread and never modified
+ * afterwards, so that any thread can read them without locking.
+ */
+class QCCTV_EncodedFrame
+{
+public:
+    QCCTV_EncodedFrame (const int resolution, const quint32 sequence,
+                        const qint64 timestamp, const QByteArray& data) :
+        m_resolution (resolution),
+        m_sequence (sequence),
+        m_timestamp (timestamp),
+        m_data (data) {}
+
+    int resolution() const
+    {
+        return m_resolution;
+    }
+
+    quint32 sequence() const
+    {
+        return m_sequence;
+    }
+
+    qint64 timestamp() const
+    {
+        return m_timestamp;
+    }
+
+    const QByteArray& data() const
+    {
+        return m_data;
+    }
+
+    bool isDelta() const;
+
+private:
+    const int m_resolution;
+    const quint32 m_sequence;
+    const qint64 m_timestamp;
+    const QByteArray m_data;
+};
+
+typedef QSharedPointer<const QCCTV_EncodedFrame> QCCTV_SharedFrame;
+typedef QMap<int, QCCTV_SharedFrame> QCCTV_FrameLadder;
+
+struct QCCTV_StreamRung {
+    int key;
+    int quality;
+    int divisor;
+    int resolution;
+    quint32 sequence;
+    quint32 recovery;
+    QCCTV_DeltaEncoder delta;
 };
 
 
@@ -68,17 +177,51 @@ extern void QCCTV_InitInfo (QCCTV_InfoPacket* packet);
 extern void QCCTV_InitImage (QCCTV_ImagePacket* packet);
 extern void QCCTV_InitCommand (QCCTV_CommandPacket* command, QCCTV_InfoPacket* stream);
 
-extern void QCCTV_WriteImagePacket (QByteArray* out,
-                                    const QCCTV_ImagePacket* image,
-                                    const QCCTV_InfoPacket* info);
+extern int QCCTV_RungKey (const int resolution, const int quality,
+                          const int divisor);
 
+extern QCCTV_FrameLadder QCCTV_CreateImageLadder
+(QList<QSharedPointer<QCCTV_StreamRung> > rungs,
+ const QCCTV_ImagePacket* image,
+ const QCCTV_InfoPacket* info,
+ const bool deltaFrames);
+
+extern int QCCTV_WriteInfoPacket (const QCCTV_InfoPacket* packet,
+                                  char* buffer, const int size);
+extern int QCCTV_WriteCommandPacket (const QCCTV_CommandPacket* packet,
+                                     char* buffer, const int size);
+extern int QCCTV_WriteAnnouncePacket (const QCCTV_AnnouncePacket* packet,
+                                      char* buffer, const int size);
+
+extern QByteArray QCCTV_CreateProbePacket();
 extern QByteArray QCCTV_CreateInfoPacket (const QCCTV_InfoPacket* packet);
+extern QByteArray QCCTV_CreateAnnouncePacket (const QCCTV_AnnouncePacket* packet);
+extern QByteArray QCCTV_CreateFrameHeader (const QCCTV_FrameHeader* header);
 extern QByteArray QCCTV_CreateCommandPacket (const QCCTV_CommandPacket* packet);
+extern QByteArray QCCTV_CreateChannelPacket (const quint8 channel,
+                                             const char* data,
+                                             const int length);
+extern QList<QByteArray> QCCTV_CreateDatagrams (const QByteArray& frame,
+                                               const quint32 id);
 extern QByteArray QCCTV_CreateImagePacket (const QCCTV_ImagePacket* packet,
-                                           const QCCTV_InfoPacket* info);
+                                           const QCCTV_InfoPacket* info,
+                                           QCCTV_DeltaEncoder* delta = NULL);
 
+extern int QCCTV_FindFrameHeader (const QByteArray& data, const int from);
+extern bool QCCTV_ReadFrameHeader (QCCTV_FrameHeader* header, const QByteArray& data);
+extern bool QCCTV_ReadFrameHeader (QCCTV_FrameHeader* header, const char* data,
+                                   const int length);
+extern bool QCCTV_ReadDatagram (QCCTV_Datagram* datagram, const QByteArray& data);
+extern bool QCCTV_ReadChannelPacket (QByteArray* payload, const QByteArray& data);
+
+extern bool QCCTV_ReadInfoVersion (quint32* version, const QByteArray& data);
 extern bool QCCTV_ReadInfoPacket (QCCTV_InfoPacket* packet, const QByteArray& data);
-extern bool QCCTV_ReadImagePacket (QCCTV_ImagePacket* packet, const QByteArray& data);
+extern bool QCCTV_ReadImagePacket (QCCTV_ImagePacket* packet, const QByteArray& data,
+                                   const bool verified = false);
 extern bool QCCTV_ReadCommandPacket (QCCTV_CommandPacket* packet, const QByteArray& data);
+extern bool QCCTV_ReadAnnouncePacket (QCCTV_AnnouncePacket* packet, const QByteArray& data);
+extern bool QCCTV_ReadProbePacket (const QByteArray& data);
+
+extern QJsonObject QCCTV_DumpPacket (const QByteArray& data);
 
 #endif
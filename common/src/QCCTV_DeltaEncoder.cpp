@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include <QBuffer>
+#include <QPainter>
+#include <QtEndian>
+
+#include "QCCTV.h"
+#include "QCCTV_DeltaEncoder.h"
+
+#if defined (__SSE2__)
+    #include <emmintrin.h>
+#elif defined (ARM_NEON_ENABLE) || defined (__ARM_NEON)
+    #include <arm_neon.h>
+#endif
+
+/*
+ * Size of the delta frame header (width, height and patch count) and the
+ * size of each patch header (position and JPEG length)
+ */
+static const int DELTA_HEADER_SIZE = 6;
+static const int PATCH_HEADER_SIZE = 8;
+
+/**
+ * Returns the sum of absolute differences between the first \a bytes
+ * of \a a and \a b
+ */
+static quint32 row_sad (const uchar* a, const uchar* b, const int bytes)
+{
+    int i = 0;
+    quint32 sad = 0;
+
+#if defined (__SSE2__)
+    __m128i sum = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128 ((const __m128i*) (a + i));
+        __m128i y = _mm_loadu_si128 ((const __m128i*) (b + i));
+        sum = _mm_add_epi64 (sum, _mm_sad_epu8 (x, y));
+    }
+
+    sad = _mm_cvtsi128_si32 (sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (sum, 8));
+#elif defined (ARM_NEON_ENABLE) || defined (__ARM_NEON)
+    uint16x8_t sum = vdupq_n_u16 (0);
+    for (; i + 16 <= bytes; i += 16)
+        sum = vpadalq_u8 (sum, vabdq_u8 (vld1q_u8 (a + i), vld1q_u8 (b + i)));
+
+    uint64x2_t sum64 = vpaddlq_u32 (vpaddlq_u16 (sum));
+    sad = vgetq_lane_u64 (sum64, 0) + vgetq_lane_u64 (sum64, 1);
+#endif
+
+    for (; i < bytes; ++i)
+        sad += qAbs (a[i] - b[i]);
+
+    return sad;
+}
+
+/**
+ * Returns \c true if the given \a rect of \a image differs from the same
+ * region of the \a reference image by more than \c QCCTV_DELTA_THRESHOLD
+ * (on average, for each color channel)
+ */
+static bool tile_changed (const QImage& image,
+                          const QImage& reference,
+                          const QRect& rect)
+{
+    quint32 sad = 0;
+    const int bytes = rect.width() * 4;
+    const int offset = rect.x() * 4;
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        sad += row_sad (image.constScanLine (y) + offset,
+                        reference.constScanLine (y) + offset,
+                        bytes);
+
+    return sad > (quint32) (rect.width() * rect.height() * 3 *
+                            QCCTV_DELTA_THRESHOLD);
+}
+
+/**
+ * Copies the given \a rect from the \a image to the \a reference image
+ */
+static void update_reference (QImage* reference,
+                              const QImage& image,
+                              const QRect& rect)
+{
+    const int bytes = rect.width() * 4;
+    const int offset = rect.x() * 4;
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        memcpy (reference->scanLine (y) + offset,
+                image.constScanLine (y) + offset,
+                bytes);
+}
+
+QCCTV_DeltaEncoder::QCCTV_DeltaEncoder()
+{
+    m_frames = 0;
+    m_keyframeRequested = true;
+}
+
+/**
+ * Forces the next frame to be a keyframe
+ */
+void QCCTV_DeltaEncoder::requestKeyframe()
+{
+    QMutexLocker lock (&m_mutex);
+    m_keyframeRequested = true;
+}
+
+/**
+ * Compares the given \a image with the reference image and writes the changed
+ * regions (encoded with the given JPEG \a quality) to the \a output.
+ *
+ * If this function returns \c false, then a keyframe must be sent instead
+ * and the \a output is not modified. In that case, the \a image becomes the
+ * new reference image.
+ */
+bool QCCTV_DeltaEncoder::encode (const QImage& image, const int quality,
+                                 QByteArray* output)
+{
+    QMutexLocker lock (&m_mutex);
+
+    /* Get the image in the same format as the reference */
+    const QImage frame = image.convertToFormat (QImage::Format_RGB32);
+    const int tile = QCCTV_DELTA_TILE_SIZE;
+    const int columns = (frame.width() + tile - 1) / tile;
+    const int rows = (frame.height() + tile - 1) / tile;
+
+    /* Check if we must send a keyframe */
+    bool keyframe = m_keyframeRequested ||
+                    m_reference.size() != frame.size() ||
+                    ++m_frames >= QCCTV_KEYFRAME_INTERVAL;
+
+    /* Get the regions that have changed (merge consecutive tiles in rows) */
+    int changed = 0;
+    QList<QRect> patches;
+    for (int row = 0; row < rows && !keyframe; ++row) {
+        QRect patch;
+        for (int column = 0; column < columns; ++column) {
+            QRect rect = QRect (column * tile, row * tile, tile, tile);
+            rect = rect.intersected (frame.rect());
+
+            if (tile_changed (frame, m_reference, rect)) {
+                patch = patch.isNull() ? rect : patch.united (rect);
+                ++changed;
+            }
+
+            else if (!patch.isNull()) {
+                patches.append (patch);
+                patch = QRect();
+            }
+        }
+
+        if (!patch.isNull())
+            patches.append (patch);
+
+        /* Sending the whole image is cheaper */
+        if (changed > (rows * columns) / 2)
+            keyframe = true;
+    }
+
+    /* Use the image as the new reference */
+    if (keyframe) {
+        m_frames = 0;
+        m_reference = frame;
+        m_keyframeRequested = false;
+        return false;
+    }
+
+    /* Write delta frame header */
+    output->resize (DELTA_HEADER_SIZE);
+    uchar* ptr = (uchar*) output->data();
+    qToBigEndian<quint16> (frame.width(), ptr);
+    qToBigEndian<quint16> (frame.height(), ptr + 2);
+    qToBigEndian<quint16> (patches.count(), ptr + 4);
+
+    /* Encode each patch and update the reference image */
+    foreach (const QRect& rect, patches) {
+        QByteArray jpeg;
+        QBuffer buffer (&jpeg);
+        frame.copy (rect).save (&buffer, "jpg", quality);
+        update_reference (&m_reference, frame, rect);
+
+        uchar header [PATCH_HEADER_SIZE];
+        qToBigEndian<quint16> (rect.x(), header);
+        qToBigEndian<quint16> (rect.y(), header + 2);
+        qToBigEndian<quint32> (jpeg.length(), header + 4);
+
+        output->append ((const char*) header, PATCH_HEADER_SIZE);
+        output->append (jpeg);
+    }
+
+    return true;
+}
+
+/**
+ * Draws the patches contained in the given delta frame \a data over the
+ * given \a image.
+ *
+ * This function shall return \c false if the delta frame was generated for
+ * an image with a different size or if the data is corrupted, in which case
+ * a new keyframe is required
+ */
+bool QCCTV_ApplyDeltaFrame (QImage* image, const QByteArray& data)
+{
+    if (!image || data.length() < DELTA_HEADER_SIZE)
+        return false;
+
+    /* Read delta frame header */
+    const uchar* ptr = (const uchar*) data.constData();
+    const int width = qFromBigEndian<quint16> (ptr);
+    const int height = qFromBigEndian<quint16> (ptr + 2);
+    const int count = qFromBigEndian<quint16> (ptr + 4);
+
+    /* Image size does not match */
+    if (image->size() != QSize (width, height))
+        return false;
+
+    /* Draw each patch over the image */
+    int offset = DELTA_HEADER_SIZE;
+    QPainter painter (image);
+    for (int i = 0; i < count; ++i) {
+        if (offset + PATCH_HEADER_SIZE > data.length())
+            return false;
+
+        const int x = qFromBigEndian<quint16> (ptr + offset);
+        const int y = qFromBigEndian<quint16> (ptr + offset + 2);
+        const quint32 length = qFromBigEndian<quint32> (ptr + offset + 4);
+        offset += PATCH_HEADER_SIZE;
+
+        if (length > (quint32) (data.length() - offset))
+            return false;
+
+        QImage patch = QImage::fromData (ptr + offset, length, "JPG");
+        if (patch.isNull())
+            return false;
+
+        painter.drawImage (x, y, patch);
+        offset += length;
+    }
+
+    return true;
+}
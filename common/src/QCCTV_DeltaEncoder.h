@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_DELTA_ENCODER_H
+#define _QCCTV_DELTA_ENCODER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QByteArray>
+
+/**
+ * \brief Generates delta frames that only contain the regions of the image
+ *        that changed since the last frame sent to the stations.
+ *
+ * The image is divided in square tiles, which are compared with the last
+ * image sent to the stations (the reference image). Consecutive changed tiles
+ * of the same row are encoded together as a small JPEG patch.
+ *
+ * A keyframe (a complete image) is required when the resolution changes,
+ * when a station requests it, when too many tiles have changed or
+ * periodically, so that stations can recover from lost frames.
+ */
+class QCCTV_DeltaEncoder
+{
+public:
+    explicit QCCTV_DeltaEncoder();
+
+    void requestKeyframe();
+    bool encode (const QImage& image, const int quality, QByteArray* output);
+
+private:
+    int m_frames;
+    QMutex m_mutex;
+    QImage m_reference;
+    bool m_keyframeRequested;
+};
+
+extern bool QCCTV_ApplyDeltaFrame (QImage* image, const QByteArray& data);
+
+#endif
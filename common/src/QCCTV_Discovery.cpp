@@ -22,18 +22,25 @@
 
 #include "QCCTV.h"
 #include "QCCTV_Discovery.h"
+#include "QCCTV_Communications.h"
 
 /**
  * Initializes the class by connecting the signals/slots between the UDP
- * receiver sockets and the datagram handlers function of this class
+ * receiver sockets and the datagram handlers function of this class, and
+ * asks the cameras in the local network to announce themselves
  */
 QCCTV_Discovery::QCCTV_Discovery()
 {
+    m_probeCount = 0;
+    m_probeTimer.setSingleShot (true);
     m_infoSocket.bind (QCCTV_INFO_PORT, QUdpSocket::ShareAddress);
     m_discoverySocket.bind (QCCTV_DISCOVERY_PORT, QUdpSocket::ShareAddress);
 
+    connect (&m_probeTimer, SIGNAL (timeout()), this, SLOT (sendProbe()));
     connect (&m_infoSocket, SIGNAL (readyRead()), this, SLOT (readInfoPacket()));
     connect (&m_discoverySocket, SIGNAL (readyRead()), this, SLOT (readDiscoveryPacket()));
+
+    probe();
 }
 
 /**
@@ -45,6 +52,32 @@ QCCTV_Discovery* QCCTV_Discovery::getInstance()
     return &instance;
 }
 
+/**
+ * Broadcasts a probe to which every camera answers directly, so that we do
+ * not need to wait for their beacons. The probe is repeated a few times (with
+ * an increasing delay) in case that the network drops it
+ */
+void QCCTV_Discovery::probe()
+{
+    m_probeCount = 0;
+    sendProbe();
+}
+
+/**
+ * Sends a probe and schedules the next one, until \c QCCTV_PROBE_RETRIES
+ * probes have been sent
+ */
+void QCCTV_Discovery::sendProbe()
+{
+    m_probeSocket.writeDatagram (QCCTV_CreateProbePacket(),
+                                 QHostAddress::Broadcast,
+                                 QCCTV_REQUEST_PORT);
+
+    m_probeCount += 1;
+    if (m_probeCount < QCCTV_PROBE_RETRIES)
+        m_probeTimer.start (QCCTV_PROBE_INTERVAL << m_probeCount);
+}
+
 /**
  * Obtains the information datagram from a remote camera and notifies the
  * \a QCCTV_Station about the new packet
@@ -63,7 +96,11 @@ void QCCTV_Discovery::readInfoPacket()
 
 /**
  * Obtains the remote host IP from which we received a packet, if the datagram
- * is valid, then the function will notify the rest of the QCCTV library
+ * is valid, then the function will notify the rest of the QCCTV library.
+ *
+ * The datagram is either an announcement (sent as a beacon or as the answer
+ * to one of our probes) or the plain beacon of an older camera, stations
+ * must handle both
  */
 void QCCTV_Discovery::readDiscoveryPacket()
 {
@@ -75,7 +112,7 @@ void QCCTV_Discovery::readDiscoveryPacket()
                                                     &address, NULL);
 
         if (bytes > 0)
-            emit newCamera (QHostAddress (address.toIPv4Address()));
+            emit newCamera (QHostAddress (address.toIPv4Address()), data);
     }
 }
 
@@ -23,6 +23,7 @@
 #ifndef _QCCTV_DISCOVERY_H
 #define _QCCTV_DISCOVERY_H
 
+#include <QTimer>
 #include <QObject>
 #include <QUdpSocket>
 #include <QHostAddress>
@@ -32,13 +33,17 @@ class QCCTV_Discovery : public QObject
     Q_OBJECT
 
 Q_SIGNALS:
-    void newCamera (const QHostAddress& camera);
     void newInfoPacket (const QHostAddress& camera, const QByteArray& data);
+    void newCamera (const QHostAddress& camera, const QByteArray& announcement);
 
 public:
     static QCCTV_Discovery* getInstance();
 
+public Q_SLOTS:
+    void probe();
+
 private Q_SLOTS:
+    void sendProbe();
     void readInfoPacket();
     void readDiscoveryPacket();
 
@@ -46,7 +51,10 @@ protected:
     QCCTV_Discovery();
 
 private:
+    int m_probeCount;
+    QTimer m_probeTimer;
     QUdpSocket m_infoSocket;
+    QUdpSocket m_probeSocket;
     QUdpSocket m_discoverySocket;
 };
 
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include "QCCTV_FrameEncoder.h"
+
+/**
+ * Moves the encoder to its own thread and starts it
+ */
+QCCTV_FrameEncoder::QCCTV_FrameEncoder() : m_input (1)
+{
+    m_queueTime = 0;
+    m_encodeTime = 0;
+    m_encodedFrames = 0;
+
+    moveToThread (&m_thread);
+    m_thread.start();
+}
+
+/**
+ * Waits for the current frame to be encoded and stops the encoder thread
+ */
+QCCTV_FrameEncoder::~QCCTV_FrameEncoder()
+{
+    m_input.clear();
+    m_thread.quit();
+    m_thread.wait();
+}
+
+/**
+ * Returns the average time (in microseconds) that a frame waits between its
+ * capture and the moment in which the encoder starts working on it
+ */
+int QCCTV_FrameEncoder::queueTime() const
+{
+    QMutexLocker locker (&m_mutex);
+    return m_queueTime;
+}
+
+/**
+ * Returns the average time (in microseconds) needed to encode all the
+ * resolution rungs of a frame
+ */
+int QCCTV_FrameEncoder::encodeTime() const
+{
+    QMutexLocker locker (&m_mutex);
+    return m_encodeTime;
+}
+
+/**
+ * Returns the number of frames that were discarded because a newer frame
+ * arrived before they could be encoded or published
+ */
+quint64 QCCTV_FrameEncoder::droppedFrames() const
+{
+    return m_input.dropped() + m_output.dropped();
+}
+
+/**
+ * Returns the number of frames encoded since the encoder was created
+ */
+quint64 QCCTV_FrameEncoder::encodedFrames() const
+{
+    QMutexLocker locker (&m_mutex);
+    return m_encodedFrames;
+}
+
+/**
+ * Queues the given \a job to be encoded in the encoder thread. If the
+ * previous job is still waiting, it is replaced by the new one
+ */
+void QCCTV_FrameEncoder::enqueue (const QCCTV_EncoderJob& job)
+{
+    m_input.push (job);
+    QMetaObject::invokeMethod (this, "process", Qt::QueuedConnection);
+}
+
+/**
+ * Moves the latest encoded frames to \a frames. Returns \c false if no
+ * frames were encoded since the last call
+ */
+bool QCCTV_FrameEncoder::takeFrames (QCCTV_FrameLadder* frames)
+{
+    return m_output.take (frames);
+}
+
+/**
+ * Encodes the queued jobs and notifies the publisher after each frame
+ */
+void QCCTV_FrameEncoder::process()
+{
+    QCCTV_EncoderJob job;
+    while (m_input.pop (&job)) {
+        const qint64 start = QCCTV_Timestamp();
+
+        /* Do not base delta frames on frames that will never be sent */
+        if (m_output.pending()) {
+            foreach (const QSharedPointer<QCCTV_StreamRung>& rung, job.rungs)
+                rung->delta.requestKeyframe();
+        }
+
+        QCCTV_FrameLadder frames = QCCTV_CreateImageLadder (job.rungs,
+                                                            &job.image,
+                                                            &job.info,
+                                                            job.deltaFrames);
+
+        const qint64 end = QCCTV_Timestamp();
+        if (frames.isEmpty())
+            continue;
+
+        m_output.publish (frames);
+
+        m_mutex.lock();
+        m_queueTime = (m_queueTime * 7 + (start - job.image.timestamp)) / 8;
+        m_encodeTime = (m_encodeTime * 7 + (end - start)) / 8;
+        ++m_encodedFrames;
+        m_mutex.unlock();
+
+        emit framesEncoded();
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_FRAME_ENCODER_H
+#define _QCCTV_FRAME_ENCODER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QSharedPointer>
+
+#include "QCCTV_FrameQueue.h"
+#include "QCCTV_Communications.h"
+
+/**
+ * Snapshot of the data needed to encode one camera frame
+ */
+struct QCCTV_EncoderJob {
+    bool deltaFrames;
+    QCCTV_InfoPacket info;
+    QCCTV_ImagePacket image;
+    QList<QSharedPointer<QCCTV_StreamRung> > rungs;
+};
+
+/**
+ * \brief Encodes the camera frames in a dedicated thread
+ *
+ * The encoder is the middle stage of the capture, encode and publish
+ * pipeline. Frames are passed to it through a bounded queue, and the encoded
+ * rungs are handed back to the publisher through a lock-free triple buffer.
+ * When the encoder or the publisher cannot keep up, the waiting frames are
+ * replaced by the newest ones instead of piling up.
+ */
+class QCCTV_FrameEncoder : public QObject
+{
+    Q_OBJECT
+
+Q_SIGNALS:
+    void framesEncoded();
+
+public:
+    explicit QCCTV_FrameEncoder();
+    ~QCCTV_FrameEncoder();
+
+    int queueTime() const;
+    int encodeTime() const;
+    quint64 droppedFrames() const;
+    quint64 encodedFrames() const;
+
+    void enqueue (const QCCTV_EncoderJob& job);
+    bool takeFrames (QCCTV_FrameLadder* frames);
+
+private Q_SLOTS:
+    void process();
+
+private:
+    QThread m_thread;
+    mutable QMutex m_mutex;
+
+    int m_queueTime;
+    int m_encodeTime;
+    quint64 m_encodedFrames;
+
+    QCCTV_FrameQueue<QCCTV_EncoderJob> m_input;
+    QCCTV_FrameBuffer<QCCTV_FrameLadder> m_output;
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_FRAME_QUEUE_H
+#define _QCCTV_FRAME_QUEUE_H
+
+#include <QQueue>
+#include <QMutex>
+#include <QAtomicInt>
+
+/**
+ * \brief Bounded queue that passes frames from one pipeline stage to the next
+ *
+ * The queue is written by a single producer thread and read by a single
+ * consumer thread. When the consumer falls behind and the queue is full, the
+ * oldest frame is dropped so that the consumer always works on the latest
+ * frames and the latency of the pipeline does not grow over time.
+ */
+template <typename T>
+class QCCTV_FrameQueue
+{
+public:
+    explicit QCCTV_FrameQueue (const int capacity = 1) :
+        m_capacity (qMax (capacity, 1)), m_dropped (0) {}
+
+    /**
+     * Returns the number of frames waiting in the queue
+     */
+    int count() const
+    {
+        QMutexLocker locker (&m_mutex);
+        return m_queue.count();
+    }
+
+    /**
+     * Returns the number of frames that were dropped because the queue was
+     * full when they were replaced by newer frames
+     */
+    quint64 dropped() const
+    {
+        QMutexLocker locker (&m_mutex);
+        return m_dropped;
+    }
+
+    /**
+     * Removes all the frames from the queue
+     */
+    void clear()
+    {
+        QMutexLocker locker (&m_mutex);
+        m_queue.clear();
+    }
+
+    /**
+     * Appends the given \a frame to the queue. If the queue is full, the
+     * oldest frame is dropped and this function returns \c false
+     */
+    bool push (const T& frame)
+    {
+        QMutexLocker locker (&m_mutex);
+
+        bool dropped = false;
+        while (m_queue.count() >= m_capacity) {
+            m_queue.dequeue();
+            ++m_dropped;
+            dropped = true;
+        }
+
+        m_queue.enqueue (frame);
+        return !dropped;
+    }
+
+    /**
+     * Moves the oldest frame of the queue to \a frame. Returns \c false if
+     * the queue is empty
+     */
+    bool pop (T* frame)
+    {
+        QMutexLocker locker (&m_mutex);
+
+        if (m_queue.isEmpty() || !frame)
+            return false;
+
+        *frame = m_queue.dequeue();
+        return true;
+    }
+
+private:
+    int m_capacity;
+    quint64 m_dropped;
+    QQueue<T> m_queue;
+    mutable QMutex m_mutex;
+};
+
+/**
+ * \brief Lock-free triple buffer that publishes the latest value of a stage
+ *
+ * The producer always writes to its own back slot and the consumer always
+ * reads from its own front slot. Publishing a value atomically swaps the back
+ * slot with the middle slot, and reading a value swaps the middle slot with
+ * the front slot, so neither thread ever waits for the other. Values that
+ * are published before the consumer reads them are replaced by newer ones.
+ */
+template <typename T>
+class QCCTV_FrameBuffer
+{
+public:
+    explicit QCCTV_FrameBuffer() :
+        m_back (0), m_front (2), m_state (1), m_dropped (0) {}
+
+    /**
+     * Returns the number of values that were replaced before the consumer
+     * could read them
+     */
+    int dropped() const
+    {
+        return m_dropped.load();
+    }
+
+    /**
+     * Returns \c true if the last published value was not read by the
+     * consumer yet, in which case the next call to \c publish() replaces it.
+     * Only the producer can make this function return \c true, so the
+     * answer stays valid for the producer until it publishes again
+     */
+    bool pending() const
+    {
+        return m_state.loadAcquire() & FRESH;
+    }
+
+    /**
+     * Publishes the given \a value. Must only be called by the producer
+     */
+    void publish (const T& value)
+    {
+        m_slots [m_back] = value;
+
+        const int old = m_state.fetchAndStoreOrdered (m_back | FRESH);
+        if (old & FRESH)
+            m_dropped.ref();
+
+        m_back = old & INDEX;
+        m_slots [m_back] = T();
+    }
+
+    /**
+     * Moves the latest published value to \a value. Returns \c false if
+     * nothing was published since the last call. Must only be called by the
+     * consumer
+     */
+    bool take (T* value)
+    {
+        if (! (m_state.loadAcquire() & FRESH) || !value)
+            return false;
+
+        m_front = m_state.fetchAndStoreOrdered (m_front) & INDEX;
+        *value = m_slots [m_front];
+        m_slots [m_front] = T();
+        return true;
+    }
+
+private:
+    enum {
+        INDEX = 0b011,
+        FRESH = 0b100,
+    };
+
+    int m_back;
+    int m_front;
+    T m_slots [3];
+    QAtomicInt m_state;
+    QAtomicInt m_dropped;
+};
+
+#endif
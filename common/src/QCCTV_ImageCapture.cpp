@@ -21,6 +21,7 @@
  */
 
 #include "yuv2rgb.h"
+#include "nv12_transform.h"
 #include "QCCTV_ImageCapture.h"
 
 #include "QCCTV.h"
@@ -35,6 +36,8 @@ QCCTV_ImageCapture::QCCTV_ImageCapture (QObject* parent) :
     QAbstractVideoSurface (parent)
 {
     m_enabled = false;
+    m_timestamp = 0;
+    m_convertTime = 0;
     m_probe = Q_NULLPTR;
     m_camera = Q_NULLPTR;
 
@@ -102,6 +105,34 @@ QImage QCCTV_ImageCapture::image() const
     return m_image;
 }
 
+/**
+ * Returns the current camera frame as a YUV image. If QCCTV was built with
+ * TurboJPEG support, YUV camera frames are not converted to RGB and
+ * \c image() returns a null image
+ */
+QCCTV_YUVImage QCCTV_ImageCapture::yuvImage() const
+{
+    return m_yuv;
+}
+
+/**
+ * Returns the time (in microseconds, see \c QCCTV_Timestamp()) in which the
+ * current frame was received from the camera
+ */
+qint64 QCCTV_ImageCapture::timestamp() const
+{
+    return m_timestamp;
+}
+
+/**
+ * Returns the average time (in microseconds) needed to convert, rotate and
+ * scale a camera frame
+ */
+int QCCTV_ImageCapture::convertTime() const
+{
+    return m_convertTime;
+}
+
 /**
  * Returns \c true if the capturer is allowed to process image frames from
  * the media source (camera)
@@ -144,24 +175,31 @@ void QCCTV_ImageCapture::setEnabled (const bool enabled)
 }
 
 /**
- * Checks if the image is valid and rotates it to fix issues with mobile/touch screens
+ * Sets the size of the largest image that QCCTV needs to send. YUV frames
+ * are downscaled while they are converted to RGB, so that the resulting image
+ * is not smaller than the given \a size. An invalid size disables this
+ */
+void QCCTV_ImageCapture::setTargetSize (const QSize& size)
+{
+    m_targetSize = size;
+}
+
+/**
+ * Checks if the image is valid and rotates it to fix issues with mobile/touch
+ * screens. If \a transform is \c false, the image is assumed to be already
+ * rotated
  */
-bool QCCTV_ImageCapture::publishImage()
+bool QCCTV_ImageCapture::publishImage (const bool transform)
 {
     /* Image is invalid or camera not loaded */
-    if (m_image.isNull() || !m_camera)
+    if ((m_image.isNull() && m_yuv.isNull()) || !m_camera) {
+        m_yuv = QCCTV_YUVImage();
         m_image = QCCTV_CreateStatusImage (QSize (640, 480), "NO CAMERA IMAGE");
+    }
 
     /* Image is valid, rotate image to compensate camera orientation */
-    else {
-        /* Get current display rotation */
-        const QScreen* screen = QGuiApplication::primaryScreen();
-        const int angle = screen->angleBetween (screen->nativeOrientation(),
-                                                screen->orientation());
-
-        /* Rotate image */
-        const int rotation = (360 - m_info.orientation() + angle) % 360;
-        m_image = m_image.transformed (QTransform().rotate (rotation));
+    else if (transform) {
+        m_image = m_image.transformed (QTransform().rotate (rotation()));
 
         /* Fix upside-down image on Windows */
 #if defined Q_OS_WIN
@@ -169,6 +207,10 @@ bool QCCTV_ImageCapture::publishImage()
 #endif
     }
 
+    /* Update conversion time */
+    const qint64 elapsed = QCCTV_Timestamp() - m_timestamp;
+    m_convertTime = (m_convertTime * 7 + elapsed) / 8;
+
     /* Notify QCCTV */
     emit newFrame();
     return !m_image.isNull();
@@ -183,11 +225,17 @@ bool QCCTV_ImageCapture::present (const QVideoFrame& frame)
     if (!frame.isValid() || !isEnabled())
         return false;
 
+    /* Register the time in which we received the frame */
+    m_timestamp = QCCTV_Timestamp();
+
     /* Clone the frame (so that we can use it) */
     QVideoFrame clone (frame);
     if (!clone.map (QAbstractVideoBuffer::ReadOnly))
         return false;
 
+    /* Forget the last YUV image */
+    m_yuv = QCCTV_YUVImage();
+
     /* Get the image format from the pixel format of the frame */
     const QImage::Format format = QVideoFrame::imageFormatFromPixelFormat (clone.pixelFormat());
 
@@ -199,6 +247,12 @@ bool QCCTV_ImageCapture::present (const QVideoFrame& frame)
                           clone.bytesPerLine(),
                           format);
 
+    /* Convert, rotate and downscale NV12/NV21 images in a single pass */
+    else if (presentYUV (clone)) {
+        clone.unmap();
+        return publishImage (false);
+    }
+
     /* This is an NV12/NV21 image (Qt does not support YUV images yet) */
     else if (clone.pixelFormat() == QVideoFrame::Format_NV12 ||
              clone.pixelFormat() == QVideoFrame::Format_NV21) {
@@ -238,3 +292,132 @@ bool QCCTV_ImageCapture::present (const QVideoFrame& frame)
     clone.unmap();
     return publishImage();
 }
+
+/**
+ * Returns the angle (in degrees) that the camera images must be rotated
+ * (clockwise) to compensate the camera and display orientation
+ */
+int QCCTV_ImageCapture::rotation() const
+{
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    const int angle = screen->angleBetween (screen->nativeOrientation(),
+                                            screen->orientation());
+
+    return (360 - m_info.orientation() + angle) % 360;
+}
+
+/**
+ * Returns the integer factor by which an image of the given \a size can be
+ * downscaled without becoming smaller than the target size
+ */
+int QCCTV_ImageCapture::scaleFactor (const QSize& size) const
+{
+    if (!m_targetSize.isValid() || size.isEmpty())
+        return 1;
+
+    QSize target = size.scaled (m_targetSize, Qt::KeepAspectRatio);
+    if (target.isEmpty())
+        return 1;
+
+    return qMax (1, qMin (size.width() / target.width(),
+                          size.height() / target.height()));
+}
+
+/**
+ * Converts the given NV12/NV21 \a frame to RGB, while rotating it and
+ * downscaling it to the target size in the same pass. This avoids going
+ * through the full-sized image three times (to convert, rotate and scale it).
+ *
+ * If QCCTV was built with TurboJPEG support, the frame is converted to a
+ * planar YUV image instead, which can be compressed without converting it
+ * to RGB first.
+ *
+ * Returns \c false if the frame cannot be processed this way
+ */
+bool QCCTV_ImageCapture::presentYUV (const QVideoFrame& frame)
+{
+    /* Only NV12 and NV21 frames are supported */
+    const bool nv21 = frame.pixelFormat() == QVideoFrame::Format_NV21;
+    if (frame.pixelFormat() != QVideoFrame::Format_NV12 && !nv21)
+        return false;
+
+    /* Only rotations in 90 degree steps are supported */
+    const int angle = rotation();
+    if (angle % 90 != 0 || !frame.bits())
+        return false;
+
+    /* Get the chroma plane */
+    const uchar* uv = frame.bits() + frame.bytesPerLine() * frame.height();
+    int uv_stride = frame.bytesPerLine();
+    if (frame.planeCount() > 1) {
+        uv = frame.bits (1);
+        uv_stride = frame.bytesPerLine (1);
+    }
+
+    /* Get the size of the rotated image and the downscale factor */
+    QSize size = frame.size();
+    if (angle == 90 || angle == 270)
+        size.transpose();
+
+    const int factor = scaleFactor (size);
+
+    /* Fix upside-down image on Windows */
+#if defined Q_OS_WIN
+    const bool flip = true;
+#else
+    const bool flip = false;
+#endif
+
+    /* Keep the YUV planes, the JPEG encoder can use them directly */
+#ifdef QCCTV_ENABLE_TURBOJPEG
+    QCCTV_YUVImage yuv = QCCTV_CreateYUVImage (size.width() / factor,
+                                               size.height() / factor);
+
+    bool success = nv12_transform_to_i420 ((uchar*) yuv.y.data(),
+                                           yuv.width,
+                                           (uchar*) yuv.u.data(),
+                                           yuv.width / 2,
+                                           (uchar*) yuv.v.data(),
+                                           yuv.width / 2,
+                                           frame.bits(),
+                                           frame.bytesPerLine(),
+                                           uv,
+                                           uv_stride,
+                                           frame.width(),
+                                           frame.height(),
+                                           factor,
+                                           angle,
+                                           flip,
+                                           nv21);
+
+    if (success) {
+        m_yuv = yuv;
+        m_image = QImage();
+    }
+
+    return success;
+#else
+    QImage image (size.width() / factor,
+                  size.height() / factor,
+                  QImage::Format_RGB888);
+
+    /* Convert the image */
+    bool success = nv12_transform_to_rgb (image.bits(),
+                                          image.bytesPerLine(),
+                                          frame.bits(),
+                                          frame.bytesPerLine(),
+                                          uv,
+                                          uv_stride,
+                                          frame.width(),
+                                          frame.height(),
+                                          factor,
+                                          angle,
+                                          flip,
+                                          nv21);
+
+    if (success)
+        m_image = image;
+
+    return success;
+#endif
+}
@@ -28,6 +28,8 @@
 #include <QCameraInfo>
 #include <QAbstractVideoSurface>
 
+#include "QCCTV.h"
+
 class QCamera;
 class QVideoProbe;
 
@@ -47,18 +49,31 @@ public:
 
     QImage image() const;
     bool isEnabled() const;
+    qint64 timestamp() const;
+    int convertTime() const;
+    QCCTV_YUVImage yuvImage() const;
 
 public Q_SLOTS:
     void setSource (QCamera* source);
     void setEnabled (const bool enabled);
+    void setTargetSize (const QSize& size);
 
 private Q_SLOTS:
-    bool publishImage();
     bool present (const QVideoFrame& frame);
+    bool publishImage (const bool transform = true);
+
+private:
+    int rotation() const;
+    int scaleFactor (const QSize& size) const;
+    bool presentYUV (const QVideoFrame& frame);
 
 private:
     bool m_enabled;
+    int m_convertTime;
+    qint64 m_timestamp;
     QImage m_image;
+    QSize m_targetSize;
+    QCCTV_YUVImage m_yuv;
     QThread m_thread;
     QCamera* m_camera;
     QCameraInfo m_info;
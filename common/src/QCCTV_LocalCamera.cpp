@@ -22,24 +22,33 @@
 
 #include <QThread>
 #include <QSysInfo>
+#include <QDateTime>
 #include <QCameraInfo>
 #include <QCameraFocus>
-#include <QFutureWatcher>
 #include <QCameraExposure>
 #include <QCameraImageCapture>
-#include <QtConcurrent/QtConcurrent>
 
 #include "QCCTV.h"
 #include "QCCTV_Watchdog.h"
 #include "QCCTV_LocalCamera.h"
 #include "QCCTV_ImageCapture.h"
+#include "QCCTV_FrameEncoder.h"
 #include "QCCTV_Communications.h"
+#include "QCCTV_Checksum.h"
 
 QCCTV_LocalCamera::QCCTV_LocalCamera (QObject* parent) : QObject (parent)
 {
     /* Initialize pointers */
+    m_codec = QCCTV_CODEC_JPEG;
+    m_frameLatency = 0;
+    m_deltaEncoding = true;
+    m_multicastEnabled = false;
+    m_infoVersion = 0;
+    m_lastHeartbeat = 0;
+    m_beaconInterval = QCCTV_BEACON_INTERVAL;
     m_camera = Q_NULLPTR;
     m_capture = Q_NULLPTR;
+    m_encoder = new QCCTV_FrameEncoder;
     m_imageCapture = new QCCTV_ImageCapture;
 
     /* Initialzie packet pointers */
@@ -55,27 +64,45 @@ QCCTV_LocalCamera::QCCTV_LocalCamera (QObject* parent) : QObject (parent)
     /* Set device name as camera name */
     infoPacket()->cameraName = deviceName();
 
+    /* Stations use this ID to tell if two addresses belong to one camera */
+    m_discoveryId = qHash (deviceName()) ^
+                    (quint32) QDateTime::currentMSecsSinceEpoch();
+
+    /* Pick a multicast group for this camera */
+    m_multicastGroup = QHostAddress (QCCTV_MULTICAST_BASE |
+                                     (qHash (deviceName()) % 254 + 1));
+
     /* Configure sockets */
     connect (&m_server,    SIGNAL (newConnection()),
              this,           SLOT (acceptConnection()));
     connect (&m_cmdSocket, SIGNAL (readyRead()),
              this,           SLOT (readCommandPacket()));
+    connect (&m_probeSocket, SIGNAL (readyRead()),
+             this,             SLOT (readProbePacket()));
+    connect (&m_beaconTimer, SIGNAL (timeout()),
+             this,             SLOT (broadcastInfo()));
 
     /* Configure listener sockets */
     m_server.listen (QHostAddress::Any, QCCTV_STREAM_PORT);
     m_cmdSocket.bind (QCCTV_COMMAND_PORT, QUdpSocket::ShareAddress);
+    m_probeSocket.bind (QCCTV_REQUEST_PORT, QUdpSocket::ShareAddress);
+    m_videoSocket.bind (QHostAddress::AnyIPv4, 0);
+    m_videoSocket.setSocketOption (QAbstractSocket::MulticastTtlOption, 1);
 
     /* Setup the frame grabber */
     connect (m_imageCapture, SIGNAL (newFrame()),
              this,             SLOT (changeImage()));
+    connect (m_encoder,      SIGNAL (framesEncoded()),
+             this,             SLOT (onImageEncoded()));
 
     /* Setup additional notifiers */
     connect (this, SIGNAL (hostCountChanged()),
              this, SIGNAL (hostNamesChanged()));
 
-    /* Start the event loops */
+    /* Start the event loops (and announce the camera right away) */
     QTimer::singleShot (1000, Qt::CoarseTimer, this, SLOT (update()));
-    QTimer::singleShot (1000, Qt::CoarseTimer, this, SLOT (broadcastInfo()));
+    m_beaconTimer.setSingleShot (true);
+    m_beaconTimer.start (0);
 }
 
 /**
@@ -90,13 +117,15 @@ QCCTV_LocalCamera::~QCCTV_LocalCamera()
     }
 
     /* Delete all watchdogs */
-    foreach (QCCTV_Watchdog* watchdog, m_watchdogs)
-        watchdog->deleteLater();
+    foreach (const QCCTV_HostState& host, m_hosts)
+        host.watchdog->deleteLater();
 
     /* Close TCP server and clear socket lists */
     m_server.close();
     m_sockets.clear();
-    m_watchdogs.clear();
+    m_hosts.clear();
+    m_beaconTimer.stop();
+    m_probeSocket.close();
     m_broadcastSocket.close();
 
     /* Delete camera capture object */
@@ -104,6 +133,7 @@ QCCTV_LocalCamera::~QCCTV_LocalCamera()
         delete m_capture;
 
     /* Delete children */
+    delete m_encoder;
     delete m_imageCapture;
     delete m_infoPacket;
     delete m_commandPacket;
@@ -117,6 +147,32 @@ int QCCTV_LocalCamera::fps()
     return infoPacket()->fps;
 }
 
+/**
+ * Returns the codec used to encode the images sent to the QCCTV stations
+ */
+int QCCTV_LocalCamera::codec()
+{
+    return infoPacket()->codec;
+}
+
+/**
+ * Returns the maximum bitrate (in kbps) of the image stream, a value of
+ * \c 0 means that the bitrate is not limited
+ */
+int QCCTV_LocalCamera::bitrate()
+{
+    return infoPacket()->bitrate;
+}
+
+/**
+ * Returns the JPEG quality selected by the rate controller to encode
+ * the images
+ */
+int QCCTV_LocalCamera::quality()
+{
+    return infoPacket()->quality;
+}
+
 /**
  * Returns the user-assigned name of the camera
  */
@@ -142,8 +198,9 @@ int QCCTV_LocalCamera::zoomLevel()
 }
 
 /**
- * Returns the current resolution as an \c int, which can be used by QML
- * interfaces directly
+ * Returns the resolution assigned to newly connected stations as an \c int,
+ * which can be used by QML interfaces directly. Each station can later
+ * subscribe to a different resolution
  */
 int QCCTV_LocalCamera::resolution()
 {
@@ -168,10 +225,19 @@ bool QCCTV_LocalCamera::supportsZoom()
 }
 
 /**
- * Returns the image that is currently being sent to the QCCTV stations
+ * Returns the image that is currently being sent to the QCCTV stations, the
+ * image may be downscaled to the largest resolution used by the stations
  */
 QImage QCCTV_LocalCamera::currentImage()
 {
+    /* The camera sends YUV images, convert the image only when needed */
+    if (imagePacket()->image.isNull()) {
+        if (m_preview.isNull())
+            m_preview = QCCTV_YUVToImage (imagePacket()->yuv);
+
+        return m_preview;
+    }
+
     return imagePacket()->image;
 }
 
@@ -183,6 +249,25 @@ QString QCCTV_LocalCamera::statusString()
     return QCCTV_GetStatusString (cameraStatus());
 }
 
+/**
+ * Returns \c true if the camera is allowed to send only the regions of the
+ * image that changed since the last frame
+ */
+bool QCCTV_LocalCamera::deltaEncoding()
+{
+    return m_deltaEncoding;
+}
+
+/**
+ * Returns \c true if the camera sends its default stream to a multicast
+ * group, which the stations can join instead of receiving the frames through
+ * their own connection
+ */
+bool QCCTV_LocalCamera::multicastEnabled()
+{
+    return m_multicastEnabled;
+}
+
 /**
  * Returns the current status of the flash light, which can be
  * set either by the camera itself or a remote QCCTV Station
@@ -246,7 +331,11 @@ bool QCCTV_LocalCamera::flashlightAvailable() const
  */
 QStringList QCCTV_LocalCamera::hostNames() const
 {
-    return m_hostNames;
+    QStringList names;
+    foreach (const QCCTV_HostState& host, m_hosts)
+        names.append (host.name);
+
+    return names;
 }
 
 /**
@@ -273,6 +362,80 @@ QStringList QCCTV_LocalCamera::availableResolutions() const
     return QCCTV_Resolutions();
 }
 
+/**
+ * Returns the timing counters of each stage of the capture, encode and
+ * publish pipeline. Times are averages, given in microseconds:
+ *
+ * - \c convertTime: time needed to convert and scale a camera frame
+ * - \c queueTime: time between the capture and the start of the encoding
+ * - \c encodeTime: time needed to encode all the resolution rungs
+ * - \c latency: time between the capture and the publication of a frame
+ * - \c encodedFrames: number of frames encoded so far
+ * - \c droppedFrames: frames replaced by newer ones before being encoded
+ *   or published
+ */
+QVariantMap QCCTV_LocalCamera::pipelineStats() const
+{
+    QVariantMap stats;
+    stats.insert ("convertTime", m_imageCapture->convertTime());
+    stats.insert ("queueTime", m_encoder->queueTime());
+    stats.insert ("encodeTime", m_encoder->encodeTime());
+    stats.insert ("latency", m_frameLatency);
+    stats.insert ("encodedFrames", m_encoder->encodedFrames());
+    stats.insert ("droppedFrames", m_encoder->droppedFrames());
+    return stats;
+}
+
+/**
+ * Returns the flow control counters of each connected host:
+ *
+ * - \c host: IP address of the host
+ * - \c name: name reported by the host
+ * - \c fps, \c quality and \c resolution: stream that the host is
+ *   subscribed to (a quality of 0 means automatic)
+ * - \c qualityLimit: JPEG quality that the host was lowered to after its
+ *   watchdog expired (0 if the host was not slowed down)
+ * - \c transport: transport used to send the frames to the host
+ * - \c multiplexed: \c true if the info and command packets are sent
+ *   through the stream connection
+ * - \c queuedBytes: bytes waiting in the socket buffer
+ * - \c queuedFrames: frames waiting for the socket buffer to drain (0 or 1)
+ * - \c sentFrames: frames written to the socket
+ * - \c droppedFrames: frames skipped because the host was too slow
+ */
+QVariantList QCCTV_LocalCamera::clientStats() const
+{
+    QVariantList list;
+    QStringList hosts = connectedHosts();
+
+    for (int i = 0; i < m_sockets.count(); ++i) {
+        const QCCTV_HostState& host = m_hosts.at (i);
+
+        QVariantMap stats;
+        stats.insert ("host", hosts.at (i));
+        stats.insert ("name", host.name);
+        stats.insert ("fps", hostFps (i));
+        stats.insert ("quality", host.quality);
+        stats.insert ("qualityLimit", host.qualityLimit);
+        stats.insert ("resolution", host.resolution);
+        if (hostUsesMulticast (i))
+            stats.insert ("transport", QCCTV_TRANSPORT_MULTICAST);
+        else if (host.videoPort > 0)
+            stats.insert ("transport", QCCTV_TRANSPORT_UDP);
+        else
+            stats.insert ("transport", QCCTV_TRANSPORT_TCP);
+
+        stats.insert ("multiplexed", host.multiplexed);
+        stats.insert ("queuedBytes", m_sockets.at (i)->bytesToWrite());
+        stats.insert ("queuedFrames", host.pendingFrame.isNull() ? 0 : 1);
+        stats.insert ("sentFrames", host.sentFrames);
+        stats.insert ("droppedFrames", host.droppedFrames);
+        list.append (stats);
+    }
+
+    return list;
+}
+
 /**
  * Attempts to take a photo using the current camera
  */
@@ -294,21 +457,49 @@ void QCCTV_LocalCamera::focusCamera()
 }
 
 /**
- * Changes the FPS of the camera
+ * Changes the FPS at which the camera captures images. Stations that are
+ * subscribed to a lower FPS receive one of every few captured frames
  */
 void QCCTV_LocalCamera::setFPS (const int fps)
 {
     if (infoPacket()->fps != QCCTV_ValidFps (fps)) {
         infoPacket()->fps = QCCTV_ValidFps (fps);
 
-        int time = QCCTV_GetWatchdogTime (infoPacket()->fps) / 2;
-        foreach (QCCTV_Watchdog* watchdog, m_watchdogs)
-            watchdog->setExpirationTime (time);
+        for (int i = 0; i < m_hosts.count(); ++i)
+            m_hosts.at (i).watchdog->setExpirationTime (
+                QCCTV_GetWatchdogTime (hostFps (i)));
 
+        updateRungs();
+        updateBudget();
         emit fpsChanged();
     }
 }
 
+/**
+ * Changes the preferred \a codec used to encode the images. The codec shall
+ * only be used if all the connected stations are able to decode it
+ */
+void QCCTV_LocalCamera::setCodec (const int codec)
+{
+    m_codec = codec;
+    updateCodec();
+}
+
+/**
+ * Changes the maximum \a bitrate (in kbps) of the image stream. The camera
+ * shall adjust the JPEG quality of each frame to stay within this budget.
+ *
+ * A \a bitrate of \c 0 disables the rate control
+ */
+void QCCTV_LocalCamera::setBitrate (const int bitrate)
+{
+    if (infoPacket()->bitrate != qMax (bitrate, 0)) {
+        infoPacket()->bitrate = qMax (bitrate, 0);
+        updateBudget();
+        emit bitrateChanged();
+    }
+}
+
 /**
  * Changes the camera used to capture images to send to the QCCTV network
  */
@@ -430,16 +621,56 @@ void QCCTV_LocalCamera::setGroup (const QString& group)
 }
 
 /**
- * Changes the resolution of the image that the camera sends to the station
+ * Changes the resolution of the images that the camera sends to newly
+ * connected stations and to every station that is currently connected
  */
 void QCCTV_LocalCamera::setResolution (const int resolution)
 {
+    for (int i = 0; i < m_hosts.count(); ++i)
+        setHostResolution (i, resolution);
+
     if (infoPacket()->resolution != resolution) {
         infoPacket()->resolution = resolution;
+        updateRungs();
         emit resolutionChanged();
     }
 }
 
+/**
+ * Allows or disallows the camera from sending delta frames (which only
+ * contain the regions of the image that changed). Delta frames are only sent
+ * if every connected station is able to decode them
+ */
+void QCCTV_LocalCamera::setDeltaEncoding (const bool enabled)
+{
+    if (m_deltaEncoding != enabled) {
+        m_deltaEncoding = enabled;
+        emit deltaEncodingChanged();
+    }
+}
+
+/**
+ * Enables or disables the multicast stream. When enabled, the group is
+ * advertised in the information packets, and the stations that join it
+ * receive the frames of the default resolution and FPS of the camera, which
+ * are sent only once, regardless of the number of stations
+ */
+void QCCTV_LocalCamera::setMulticastEnabled (const bool enabled)
+{
+    if (m_multicastEnabled != enabled) {
+        m_multicastEnabled = enabled;
+        infoPacket()->multicastPort = enabled ? QCCTV_MULTICAST_PORT : 0;
+        infoPacket()->multicastGroup = enabled ? m_multicastGroup.toString() :
+                                       QString ("");
+
+        updateRungs();
+        for (int i = 0; i < m_sockets.count(); ++i)
+            requestKeyframe (i);
+
+        emit multicastEnabledChanged();
+    }
+}
+
 /**
  * Turns on or off the flashlight based on the value of the \a enabled
  * parameter
@@ -470,7 +701,9 @@ void QCCTV_LocalCamera::setAutoRegulateResolution (const bool regulate)
 }
 
 /**
- * Obtains a new image from the camera and updates the camera status
+ * Obtains a new image from the camera and updates the camera status. Images
+ * are sent by \c onImageEncoded() as soon as they are ready, this function
+ * only paces the capture to the FPS of the camera
  */
 void QCCTV_LocalCamera::update()
 {
@@ -480,7 +713,6 @@ void QCCTV_LocalCamera::update()
 
     /* Update camera info and send it */
     sendInfo();
-    sendImage();
     updateStatus();
 
     /* Call the update function again */
@@ -488,27 +720,166 @@ void QCCTV_LocalCamera::update()
 }
 
 /**
- * Sends a camera information packet to all connected hosts
+ * Sends a camera information packet to the connected hosts, each packet
+ * reports the resolution, FPS and quality that the host is subscribed to.
+ *
+ * Packets are only sent to a host when its information changes (which also
+ * changes the version of the information), and to every host once every
+ * \c QCCTV_INFO_HEARTBEAT milliseconds, in case that a packet was lost
  */
 void QCCTV_LocalCamera::sendInfo()
 {
-    QByteArray info = QCCTV_CreateInfoPacket (infoPacket());
-    foreach (QString address, connectedHosts())
-        m_infoSocket.writeDatagram (info,
-                                    QHostAddress (address),
-                                    QCCTV_INFO_PORT);
+    char buffer [QCCTV_PACKET_MAX_SIZE];
+    QCCTV_InfoPacket packet = *infoPacket();
+    QStringList hosts = connectedHosts();
+
+    /* Check if we should send the heartbeat packets */
+    const qint64 now = QCCTV_Timestamp() / 1000;
+    const bool heartbeat = (now - m_lastHeartbeat) >= QCCTV_INFO_HEARTBEAT;
+    if (heartbeat)
+        m_lastHeartbeat = now;
+
+    for (int i = 0; i < hosts.count(); ++i) {
+        packet.fps = hostFps (i);
+        packet.resolution = m_hosts.at (i).resolution;
+        packet.quality = hostQuality (i) > 0 ? hostQuality (i) :
+                         infoPacket()->quality;
+
+        /* Multicast hosts receive the default stream of the camera */
+        if (hostUsesMulticast (i)) {
+            packet.quality = infoPacket()->quality;
+            packet.resolution = infoPacket()->resolution;
+        }
+
+        /* Acknowledge the last commands sent by the host */
+        packet.commandAck = m_hosts.at (i).commands;
+
+        /* Compare the packet with the last packet sent to the host */
+        packet.version = 0;
+        int length = QCCTV_WriteInfoPacket (&packet, buffer, sizeof (buffer));
+        if (length <= 0)
+            continue;
+
+        const QByteArray info = QByteArray::fromRawData (buffer, length);
+        const bool changed = (m_hosts.at (i).info != info);
+        if (changed) {
+            m_infoVersion += 1;
+            m_hosts [i].info = QByteArray (buffer, length);
+        }
+
+        /* Nothing to send */
+        if (!changed && !heartbeat)
+            continue;
+
+        /* Send the packet with the current version */
+        packet.version = m_infoVersion;
+        length = QCCTV_WriteInfoPacket (&packet, buffer, sizeof (buffer));
+
+        /* Multiplexed hosts receive the packet before any pending frame */
+        if (m_hosts.at (i).multiplexed)
+            m_sockets.at (i)->write (QCCTV_CreateChannelPacket (
+                                         QCCTV_CHANNEL_INFO, buffer, length));
+        else
+            m_infoSocket.writeDatagram (buffer, length,
+                                        QHostAddress (hosts.at (i)),
+                                        QCCTV_INFO_PORT);
+    }
 }
 
 /**
- * Sends an image packet to all connected hosts
+ * Sends to each connected host the newly encoded image packet of the
+ * resolution rung that it is subscribed to. The frames are released after
+ * being sent, so that each frame is sent only once to each host.
+ *
+ * If a host has not received the previous frame yet, the new frame is kept
+ * aside until the socket is drained (see \c onBytesWritten()). If another
+ * frame arrives before that, the waiting frame is dropped and replaced, so
+ * that a slow host always skips to the newest frame instead of building up
+ * a queue in the socket buffer. A host that missed a frame cannot decode the
+ * delta frames that follow it, so it skips them until its rung sends a
+ * keyframe, which we request right away (see \c recoverHost()).
+ *
+ * Hosts that selected the UDP transport receive the frames as datagrams,
+ * lost datagrams are never re-sent. Hosts that joined the multicast group
+ * share a single copy of each datagram
  */
 void QCCTV_LocalCamera::sendImage()
 {
-    if (!m_data.isEmpty()) {
-        foreach (QTcpSocket* socket, m_sockets)
-            if (socket->isWritable())
-                socket->write (m_data);
+    bool multicast = false;
+
+    for (int i = 0; i < m_sockets.count(); ++i) {
+        QTcpSocket* socket = m_sockets.at (i);
+        QCCTV_SharedFrame frame = m_frames.value (hostRung (i));
+
+        if (frame.isNull() || !socket->isWritable())
+            continue;
+
+        /* Host receives the multicast stream */
+        if (hostUsesMulticast (i)) {
+            m_hosts [i].sentFrames += 1;
+            multicast = true;
+            continue;
+        }
+
+        /* Host receives the frames through UDP, never wait for it */
+        if (m_hosts.at (i).videoPort > 0) {
+            QHostAddress address (socket->peerAddress().toIPv4Address());
+            foreach (QByteArray datagram,
+                     QCCTV_CreateDatagrams (frame->data(), frame->sequence()))
+                m_videoSocket.writeDatagram (datagram, address,
+                                             m_hosts.at (i).videoPort);
+
+            m_hosts [i].sentFrames += 1;
+            continue;
+        }
+
+        /* Host missed a frame, wait for the next keyframe */
+        if (m_hosts.at (i).waitingKeyframe) {
+            if (frame->isDelta()) {
+                m_hosts [i].droppedFrames += 1;
+                m_hosts.at (i).watchdog->reset();
+                recoverHost (i, frame->sequence());
+                continue;
+            }
+
+            m_hosts [i].waitingKeyframe = false;
+        }
+
+        /* Previous frame is still being sent, wait for it */
+        if (socket->bytesToWrite() > 0) {
+            if (!m_hosts.at (i).pendingFrame.isNull()) {
+                m_hosts [i].droppedFrames += 1;
+
+                /* The new frame is based on the frame that we dropped */
+                if (frame->isDelta()) {
+                    m_hosts [i].droppedFrames += 1;
+                    m_hosts [i].waitingKeyframe = true;
+                    m_hosts [i].pendingFrame = QCCTV_SharedFrame();
+                    recoverHost (i, frame->sequence());
+                    continue;
+                }
+            }
+
+            m_hosts [i].pendingFrame = frame;
+        }
+
+        /* Socket is drained, send the frame now */
+        else {
+            socket->write (frame->data());
+            m_hosts [i].sentFrames += 1;
+        }
+    }
+
+    /* Send the multicast stream once, regardless of the number of hosts */
+    if (multicast) {
+        QCCTV_SharedFrame frame = m_frames.value (multicastRung());
+        foreach (QByteArray datagram,
+                 QCCTV_CreateDatagrams (frame->data(), frame->sequence()))
+            m_videoSocket.writeDatagram (datagram, m_multicastGroup,
+                                         QCCTV_MULTICAST_PORT);
     }
+
+    m_frames.clear();
 }
 
 /**
@@ -521,30 +892,131 @@ void QCCTV_LocalCamera::changeImage()
 
     /* Re-assign image */
     imagePacket()->image = m_imageCapture->image();
+    imagePacket()->yuv = m_imageCapture->yuvImage();
+    imagePacket()->timestamp = m_imageCapture->timestamp();
+    m_preview = QImage();
     emit imageChanged();
 
-    /* Generate the socket data and send it */
-    QFutureWatcher<void>* watcher = new QFutureWatcher<void> (this);
-    connect (watcher, SIGNAL (finished()), watcher, SLOT (deleteLater()));
-    watcher->setFuture (QtConcurrent::run (QCCTV_WriteImagePacket,
-                                           &m_data, imagePacket(),
-                                           infoPacket()));
+    /* Nobody is watching */
+    if (m_rungs.isEmpty())
+        return;
+
+    /* Only use delta frames if all stations support them */
+    bool delta = deltaEncoding() && codec() == QCCTV_CODEC_JPEG;
+    foreach (const QCCTV_HostState& host, m_hosts)
+        if (! (host.capabilities & QCCTV_CAPABILITY_DELTA))
+            delta = false;
+
+    /* Start with a keyframe when delta frames are enabled again */
+    if (!delta) {
+        foreach (QSharedPointer<QCCTV_StreamRung> rung, m_rungs)
+            rung->delta.requestKeyframe();
+    }
+
+    /* Count the frames, so that each rung knows which frames to encode */
+    imagePacket()->sequence += 1;
 
+    /* Hand a snapshot of the frame to the encoder thread */
+    QCCTV_EncoderJob job;
+    job.deltaFrames = delta;
+    job.info = *infoPacket();
+    job.image = *imagePacket();
+    job.rungs = m_rungs.values();
+    m_encoder->enqueue (job);
+}
+
+/**
+ * Takes the latest frames published by the encoder thread, sends them to the
+ * connected hosts and feeds the size of the highest resolution rung that
+ * uses the automatic JPEG quality to the rate controller
+ */
+void QCCTV_LocalCamera::onImageEncoded()
+{
+    if (m_encoder->takeFrames (&m_frames) && !m_frames.isEmpty()) {
+        QCCTV_SharedFrame frame = m_frames.last();
+        m_frameLatency = (m_frameLatency * 7 +
+                          (QCCTV_Timestamp() - frame->timestamp())) / 8;
+
+        /* Feed the largest rung that uses the automatic quality */
+        QMapIterator<int, QCCTV_SharedFrame> it (m_frames);
+        it.toBack();
+        while (it.hasPrevious()) {
+            it.previous();
+            QSharedPointer<QCCTV_StreamRung> rung = m_rungs.value (it.key());
+            if (!rung.isNull() && rung->quality == 0) {
+                m_rateController.addFrame (it.value()->data().size());
+                updateQuality();
+                break;
+            }
+        }
+
+        sendImage();
+    }
 }
 
 /**
  * Creates and sends a new packet that announces the existence of this
- * camera to the local network
+ * camera to the local network.
+ *
+ * Stations find new cameras by probing them, so the beacon only needs to be
+ * frequent right after the camera starts (or loses its last station). The
+ * interval doubles after every beacon, and we switch to a slow beacon while
+ * a station is connected, so that a site with many cameras does not flood
+ * the network with broadcasts
  */
 void QCCTV_LocalCamera::broadcastInfo()
 {
-    QString str = "QCCTV_DISCOVERY_SERVICE";
-
-    m_broadcastSocket.writeDatagram (str.toUtf8(),
+    m_broadcastSocket.writeDatagram (announcePacket(),
                                      QHostAddress::Broadcast,
                                      QCCTV_DISCOVERY_PORT);
 
-    QTimer::singleShot (1000, this, SLOT (broadcastInfo()));
+    if (m_sockets.isEmpty()) {
+        m_beaconTimer.start (m_beaconInterval);
+        m_beaconInterval = qMin (m_beaconInterval * 2,
+                                 QCCTV_BEACON_MAX_INTERVAL);
+    }
+
+    else
+        m_beaconTimer.start (QCCTV_BEACON_SLOW_INTERVAL);
+}
+
+/**
+ * Reads the probes broadcasted by the stations, each station that probed
+ * us receives our announcement directly (after a small delay that is
+ * different for each camera, so that the answers of many cameras do not
+ * arrive at once)
+ */
+void QCCTV_LocalCamera::readProbePacket()
+{
+    while (m_probeSocket.hasPendingDatagrams()) {
+        QByteArray data;
+        QHostAddress address;
+        data.resize (m_probeSocket.pendingDatagramSize());
+        m_probeSocket.readDatagram (data.data(), data.size(), &address);
+
+        address = QHostAddress (address.toIPv4Address());
+        if (QCCTV_ReadProbePacket (data) && !m_probeReplies.contains (address))
+            m_probeReplies.append (address);
+    }
+
+    if (!m_probeReplies.isEmpty())
+        QTimer::singleShot (m_discoveryId % QCCTV_PROBE_JITTER, this,
+                            SLOT (answerProbes()));
+}
+
+/**
+ * Sends our announcement to every station that probed us
+ */
+void QCCTV_LocalCamera::answerProbes()
+{
+    if (m_probeReplies.isEmpty())
+        return;
+
+    const QByteArray packet = announcePacket();
+    foreach (QHostAddress address, m_probeReplies)
+        m_broadcastSocket.writeDatagram (packet, address, QCCTV_DISCOVERY_PORT);
+
+    m_probeReplies.clear();
 }
 
 /**
@@ -561,13 +1033,22 @@ void QCCTV_LocalCamera::onDisconnected()
 
     /* Delete objects */
     m_sockets.at (index)->deleteLater();
-    m_watchdogs.at (index)->deleteLater();
+    m_hosts.at (index).watchdog->deleteLater();
 
     /* Unregister watchdog and socket */
     m_sockets.removeAt (index);
-    m_watchdogs.removeAt (index);
+    m_hosts.removeAt (index);
+
+    /* Beacon quickly again, so that stations find us sooner */
+    if (m_sockets.isEmpty()) {
+        m_beaconInterval = QCCTV_BEACON_INTERVAL;
+        m_beaconTimer.start (m_beaconInterval);
+    }
 
     /* Notify application */
+    updateRungs();
+    updateCodec();
+    updateChecksum();
     emit hostCountChanged();
 }
 
@@ -581,19 +1062,41 @@ void QCCTV_LocalCamera::acceptConnection()
         QCCTV_Watchdog* watchdog = new QCCTV_Watchdog (this);
         watchdog->setExpirationTime (QCCTV_GetWatchdogTime (infoPacket()->fps));
 
-        m_watchdogs.append (watchdog);
-        m_hostNames.append ("Unknown");
+        QCCTV_HostState host;
+        host.name = "Unknown";
+        host.codecs = 1 << QCCTV_CODEC_ZLIB;
+        host.checksums = 1 << QCCTV_CHECKSUM_CRC32;
+        host.fps = fps();
+        host.quality = 0;
+        host.qualityLimit = 0;
+        host.videoPort = 0;
+        host.resolution = resolution();
+        host.capabilities = 0;
+        host.sentFrames = 0;
+        host.droppedFrames = 0;
+        host.multiplexed = false;
+        host.waitingKeyframe = false;
+        host.commands = 0;
+        host.watchdog = watchdog;
+
+        m_hosts.append (host);
         m_sockets.append (m_server.nextPendingConnection());
         m_sockets.last()->setSocketOption (QTcpSocket::LowDelayOption, 1);
         m_sockets.last()->setSocketOption (QTcpSocket::KeepAliveOption, 1);
 
-        connect (m_watchdogs.last(), SIGNAL (expired()),
+        connect (watchdog,           SIGNAL (expired()),
                  this,                 SLOT (onWatchdogTimeout()));
         connect (m_sockets.last(),   SIGNAL (disconnected()),
                  this,                 SLOT (onDisconnected()));
         connect (m_sockets.last(),   SIGNAL (bytesWritten (qint64)),
                  this,                 SLOT (onBytesWritten (qint64)));
+        connect (m_sockets.last(),   SIGNAL (readyRead()),
+                 this,                 SLOT (onStreamDataReceived()));
 
+        updateRungs();
+        updateCodec();
+        updateChecksum();
+        requestKeyframe (m_sockets.count() - 1);
         emit hostCountChanged();
     }
 }
@@ -603,9 +1106,13 @@ void QCCTV_LocalCamera::acceptConnection()
  *
  * This packet contains the following data/instructions:
  *
- * - A new FPS to use
  * - The new light status
  * - A force focus request
+ * - The resolution, FPS and JPEG quality that the station wants to receive
+ *
+ * Each packet carries the sequence number of the last commands issued by the
+ * station, which are applied only once and acknowledged through the info
+ * packets. The station re-sends the commands until they are acknowledged
  */
 void QCCTV_LocalCamera::readCommandPacket()
 {
@@ -615,63 +1122,226 @@ void QCCTV_LocalCamera::readCommandPacket()
     data.resize (m_cmdSocket.pendingDatagramSize());
     m_cmdSocket.readDatagram (data.data(), data.length(), &address);
 
+    /* Find the station that sent the packet */
+    QString ip = QHostAddress (address.toIPv4Address()).toString();
+    int index = connectedHosts().indexOf (ip);
+    if (index >= 0)
+        readCommand (index, data);
+}
+
+/**
+ * Reads the command packet \a data sent by the station at the given \a index
+ * through the command socket or through its stream connection
+ */
+void QCCTV_LocalCamera::readCommand (const int index, const QByteArray& data)
+{
     /* Read the command packet */
-    bool success = QCCTV_ReadCommandPacket (commandPacket(), data);
-    if (!success)
+    if (!QCCTV_ReadCommandPacket (commandPacket(), data))
         return;
 
     /* Change host name */
-    QString ip = QHostAddress (address.toIPv4Address()).toString();
-    if (connectedHosts().contains (ip)) {
-        int index = connectedHosts().indexOf (ip);
-        if (m_hostNames.at (index) != commandPacket()->host) {
-            m_hostNames.replace (index, commandPacket()->host);
-            emit hostNamesChanged();
-        }
+    if (m_hosts.at (index).name != commandPacket()->host) {
+        m_hosts [index].name = commandPacket()->host;
+        emit hostNamesChanged();
     }
 
-    /* Change FPS */
-    if (commandPacket()->fpsChanged)
-        if (commandPacket()->oldFps == fps())
-            setFPS (commandPacket()->newFps);
+    /* Stations that do not report their codecs only support zlib */
+    int codecs = commandPacket()->supportedCodecs;
+    if (codecs == 0)
+        codecs = 1 << QCCTV_CODEC_ZLIB;
 
-    /* Change zoom */
-    if (commandPacket()->zoomChanged)
-        if (commandPacket()->oldZoom == zoomLevel())
-            setZoomLevel (commandPacket()->newZoom);
+    /* Update the codecs supported by the station */
+    if (m_hosts.at (index).codecs != codecs) {
+        m_hosts [index].codecs = codecs;
+        updateCodec();
+    }
+
+    /* Stations that do not report their checksums only support CRC32 */
+    int checksums = commandPacket()->supportedChecksums;
+    if (checksums == 0)
+        checksums = 1 << QCCTV_CHECKSUM_CRC32;
+
+    /* Update the checksum algorithms supported by the station */
+    if (m_hosts.at (index).checksums != checksums) {
+        m_hosts [index].checksums = checksums;
+        updateChecksum();
+    }
+
+    /* Update the features supported by the station */
+    bool multicast = hostUsesMulticast (index);
+    m_hosts [index].capabilities = commandPacket()->capabilities;
+
+    /* Station joined (or left) the multicast group */
+    if (multicast != hostUsesMulticast (index)) {
+        updateRungs();
+        requestKeyframe (index);
+    }
+
+    /* Send frames through UDP (or switch back to TCP) */
+    if (m_hosts.at (index).videoPort != commandPacket()->videoPort) {
+        m_hosts [index].videoPort = commandPacket()->videoPort;
+        requestKeyframe (index);
+    }
+
+    /* UDP hosts do not write to the socket, command packets act as acks */
+    if (m_hosts.at (index).videoPort > 0 || hostUsesMulticast (index))
+        m_hosts.at (index).watchdog->reset();
+
+    /* Subscribe the station to another JPEG quality */
+    setHostQuality (index, commandPacket()->quality);
+
+    /* Send a complete image in the next frame */
+    if (commandPacket()->keyframeRequest)
+        requestKeyframe (index);
 
-    /* Set resolution */
-    if (commandPacket()->resolutionChanged)
-        if (commandPacket()->oldResolution == resolution())
-            setResolution (commandPacket()->newResolution);
+    /* Apply the commands only once, even if the packet was re-sent */
+    const quint32 sequence = commandPacket()->sequence;
+    if ((qint32) (sequence - m_hosts.at (index).commands) > 0) {
+        m_hosts [index].commands = sequence;
+        applyCommands (index);
+    }
+
+    /* Acknowledge the commands (again, if the station re-sent them) */
+    if (commandPacket()->fields != 0) {
+        m_hosts [index].info = QByteArray();
+        sendInfo();
+    }
+}
+
+/**
+ * Applies the fields of the command packet that the station at the given
+ * \a host index asked us to change, the other fields are ignored
+ */
+void QCCTV_LocalCamera::applyCommands (const int host)
+{
+    const int fields = commandPacket()->fields;
+
+    /* Subscribe the station to another resolution */
+    if (fields & QCCTV_COMMAND_RESOLUTION)
+        setHostResolution (host, commandPacket()->resolution);
+
+    /* Subscribe the station to another FPS */
+    if (fields & QCCTV_COMMAND_FPS)
+        setHostFps (host, commandPacket()->fps);
+
+    /* Change bitrate */
+    if (fields & QCCTV_COMMAND_BITRATE)
+        setBitrate (commandPacket()->bitrate);
+
+    /* Change zoom */
+    if (fields & QCCTV_COMMAND_ZOOM)
+        setZoomLevel (commandPacket()->zoom);
 
     /* Set flashlight status */
-    if (commandPacket()->flashlightEnabledChanged)
-        if (commandPacket()->oldFlashlightEnabled == flashlightEnabled())
-            setFlashlightEnabled (commandPacket()->newFlashlightEnabled);
+    if (fields & QCCTV_COMMAND_FLASHLIGHT)
+        setFlashlightEnabled (commandPacket()->flashlightEnabled);
 
     /* Change the auto-regulate resolution option */
-    if (commandPacket()->autoRegulateResolutionChanged)
-        if (commandPacket()->oldAutoRegulateResolution == autoRegulateResolution())
-            setAutoRegulateResolution (commandPacket()->newAutoRegulateResolution);
+    if (fields & QCCTV_COMMAND_AUTOREGRES)
+        setAutoRegulateResolution (commandPacket()->autoRegulateResolution);
 
     /* Focus the camera */
-    if (commandPacket()->focusRequest)
+    if (fields & QCCTV_COMMAND_FOCUS)
         focusCamera();
 }
 
 /**
- * Gradually lowers the image quality when the station fails to reply on time
+ * Gradually lowers the image quality when the station fails to reply on time.
+ * The JPEG quality is lowered first, the resolution of the station is only
+ * lowered when we cannot lower the JPEG quality anymore (or when the station
+ * asked for a fixed JPEG quality).
+ *
+ * Only the stream of the slow station is degraded: it is moved to a rung of
+ * its own with a lower JPEG quality, so the stations that share the automatic
+ * quality are not affected
  */
 void QCCTV_LocalCamera::onWatchdogTimeout()
 {
-    if (resolution() == QCCTV_QCIF || !autoRegulateResolution())
+    QCCTV_Watchdog* watchdog = qobject_cast<QCCTV_Watchdog*> (sender());
+    int index = -1;
+    for (int i = 0; i < m_hosts.count(); ++i)
+        if (m_hosts.at (i).watchdog == watchdog)
+            index = i;
+
+    if (index < 0)
+        return;
+
+    if (m_hosts.at (index).quality == 0) {
+        int quality = m_hosts.at (index).qualityLimit;
+        if (quality == 0)
+            quality = infoPacket()->quality;
+
+        if (quality > QCCTV_MIN_QUALITY) {
+            m_hosts [index].qualityLimit = qMax (QCCTV_MIN_QUALITY,
+                                                 quality - 10);
+            updateRungs();
+            requestKeyframe (index);
+            return;
+        }
+    }
+
+    int resolution = m_hosts.at (index).resolution;
+    if (resolution == QCCTV_QCIF || !autoRegulateResolution())
         return;
 
-    if (connectedHosts().isEmpty())
+    setHostResolution (index, qMax ((int) QCCTV_CIF, resolution - 1));
+}
+
+/**
+ * Reads the command packets that the station sent through its stream
+ * connection. Stations that do this are multiplexed: from now on, we send
+ * their info packets through the stream connection instead of UDP
+ */
+void QCCTV_LocalCamera::onStreamDataReceived()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*> (sender());
+    int index = m_sockets.indexOf (socket);
+    if (index < 0)
         return;
 
-    setResolution ((QCCTV_Resolution) qMax ((int) QCCTV_CIF, resolution() - 1));
+    m_hosts [index].buffer.append (socket->readAll());
+
+    QCCTV_FrameHeader header;
+    while (m_hosts.at (index).buffer.size() >= QCCTV_FRAME_HEADER_SIZE) {
+        QByteArray& data = m_hosts [index].buffer;
+
+        /* Header is invalid, skip to the next frame header */
+        if (!QCCTV_ReadFrameHeader (&header, data)) {
+            int start = QCCTV_FindFrameHeader (data, 1);
+            if (start > 0)
+                data.remove (0, start);
+            else
+                data.remove (0, data.size() - 3);
+
+            continue;
+        }
+
+        /* Wait until we receive the whole frame */
+        const int length = QCCTV_FRAME_HEADER_SIZE + header.length;
+        if (data.size() < length)
+            return;
+
+        /* Remove the frame from the buffer */
+        QByteArray payload;
+        QByteArray frame = data.left (length);
+        data.remove (0, length);
+
+        /* Read the command packet */
+        if (header.channel == QCCTV_CHANNEL_COMMAND &&
+            QCCTV_ReadChannelPacket (&payload, frame)) {
+            if (!m_hosts.at (index).multiplexed) {
+                m_hosts [index].multiplexed = true;
+                m_hosts [index].info = QByteArray();
+            }
+
+            readCommand (index, payload);
+        }
+
+        /* Host may have been disconnected while reading the command */
+        index = m_sockets.indexOf (socket);
+        if (index < 0)
+            return;
+    }
 }
 
 /**
@@ -680,9 +1350,68 @@ void QCCTV_LocalCamera::onWatchdogTimeout()
 void QCCTV_LocalCamera::onBytesWritten (const qint64 bytes)
 {
     QTcpSocket* socket = qobject_cast<QTcpSocket*> (sender());
+    int index = m_sockets.indexOf (socket);
+
+    if (index < 0 || bytes <= 0)
+        return;
 
-    if (socket && bytes > 0)
-        m_watchdogs.at (m_sockets.indexOf (socket))->reset();
+    QCCTV_HostState& host = m_hosts [index];
+    host.watchdog->reset();
+
+    /* Socket is drained, send the frame that was waiting for it */
+    if (socket->bytesToWrite() == 0 && !host.pendingFrame.isNull()) {
+        socket->write (host.pendingFrame->data());
+        host.pendingFrame = QCCTV_SharedFrame();
+        host.sentFrames += 1;
+    }
+}
+
+/**
+ * Selects the codec used to encode the images, the preferred codec is used
+ * only if all connected stations support it. Otherwise, we fall back to
+ * JPEG or to zlib-compressed JPEG for older stations
+ */
+void QCCTV_LocalCamera::updateCodec()
+{
+    /* Get the codecs supported by every host */
+    int codecs = QCCTV_SupportedCodecs();
+    foreach (const QCCTV_HostState& host, m_hosts)
+        codecs &= host.codecs;
+
+    /* Select the codec to use */
+    int codec = QCCTV_CODEC_ZLIB;
+    if (codecs & (1 << m_codec))
+        codec = m_codec;
+    else if (codecs & (1 << QCCTV_CODEC_JPEG))
+        codec = QCCTV_CODEC_JPEG;
+
+    /* Update the codec */
+    if (infoPacket()->codec != codec) {
+        infoPacket()->codec = codec;
+        emit codecChanged();
+    }
+}
+
+/**
+ * Selects the fastest integrity algorithm that is supported by this camera
+ * and by every connected station. The algorithm is written in the header of
+ * each frame, so frames that were encoded before the change are still valid
+ */
+void QCCTV_LocalCamera::updateChecksum()
+{
+    int algorithms = QCCTV_SupportedChecksums();
+    foreach (const QCCTV_HostState& host, m_hosts)
+        algorithms &= host.checksums;
+
+    infoPacket()->checksum = QCCTV_Checksum::preferredAlgorithm (algorithms);
+}
+
+/**
+ * Converts the bitrate to a bytes-per-frame budget for the rate controller
+ */
+void QCCTV_LocalCamera::updateBudget()
+{
+    m_rateController.setBudget (bitrate() * 125 / fps());
 }
 
 /**
@@ -708,6 +1437,243 @@ void QCCTV_LocalCamera::updateStatus()
 }
 
 
+/**
+ * Creates the stream rungs that connected stations are subscribed to and
+ * removes the rungs that are not used anymore. Stations with the same
+ * resolution, FPS and quality share the same rung. Rungs that are still
+ * being encoded are deleted once the encoder releases them
+ */
+void QCCTV_LocalCamera::updateRungs()
+{
+    /* Add new rungs */
+    QList<int> keys;
+    for (int i = 0; i < m_sockets.count(); ++i) {
+        int key = hostRung (i);
+        keys.append (key);
+
+        if (!m_rungs.contains (key)) {
+            QSharedPointer<QCCTV_StreamRung> rung (new QCCTV_StreamRung);
+            rung->key = key;
+            rung->sequence = 0;
+            rung->recovery = 0;
+            rung->divisor = hostDivisor (i);
+            rung->quality = hostQuality (i);
+            rung->resolution = m_hosts.at (i).resolution;
+
+            /* The multicast rung uses the defaults of the camera */
+            if (hostUsesMulticast (i)) {
+                rung->divisor = 1;
+                rung->quality = 0;
+                rung->resolution = infoPacket()->resolution;
+            }
+
+            m_rungs.insert (key, rung);
+        }
+    }
+
+    /* Remove unused rungs */
+    foreach (int key, m_rungs.keys())
+        if (!keys.contains (key))
+            m_rungs.remove (key);
+
+    /* Let the capturer downscale the images to the largest rung */
+    QSize size;
+    if (!m_rungs.isEmpty())
+        size = QCCTV_GetResolution (m_rungs.last()->resolution);
+
+    QMetaObject::invokeMethod (m_imageCapture, "setTargetSize",
+                               Q_ARG (QSize, size));
+}
+
+/**
+ * Reports the JPEG quality selected by the rate controller to the stations.
+ * Slow stations that were limited to a quality that is no longer lower than
+ * the selected quality go back to the shared stream
+ */
+void QCCTV_LocalCamera::updateQuality()
+{
+    if (infoPacket()->quality != m_rateController.quality()) {
+        infoPacket()->quality = m_rateController.quality();
+
+        QList<int> hosts;
+        for (int i = 0; i < m_hosts.count(); ++i) {
+            const int limit = m_hosts.at (i).qualityLimit;
+            if (limit > 0 && limit >= infoPacket()->quality) {
+                m_hosts [i].qualityLimit = 0;
+                hosts.append (i);
+            }
+        }
+
+        if (!hosts.isEmpty()) {
+            updateRungs();
+            foreach (int host, hosts)
+                requestKeyframe (host);
+        }
+
+        emit qualityChanged();
+    }
+}
+
+/**
+ * Forces the rung that the given \a host is subscribed to to send a complete
+ * image in the next frame
+ */
+void QCCTV_LocalCamera::requestKeyframe (const int host)
+{
+    if (host >= 0 && host < m_hosts.count()) {
+        QSharedPointer<QCCTV_StreamRung> rung;
+        rung = m_rungs.value (hostRung (host));
+
+        if (!rung.isNull())
+            rung->delta.requestKeyframe();
+    }
+}
+
+/**
+ * Asks the rung of the given \a host for a keyframe, so that a host that
+ * skipped a frame can decode its stream again. The \a sequence is the one of
+ * the last frame of the rung.
+ *
+ * The rung is shared with other hosts, so these keyframes are requested at
+ * most once every \c QCCTV_RECOVERY_INTERVAL frames of the rung
+ */
+void QCCTV_LocalCamera::recoverHost (const int host, const quint32 sequence)
+{
+    QSharedPointer<QCCTV_StreamRung> rung = m_rungs.value (hostRung (host));
+    if (rung.isNull())
+        return;
+
+    if (rung->recovery == 0 ||
+        (qint32) (sequence - rung->recovery) >= QCCTV_RECOVERY_INTERVAL) {
+        rung->recovery = sequence;
+        rung->delta.requestKeyframe();
+    }
+}
+
+/**
+ * Returns the FPS of the stream received by the given \a host, which is the
+ * FPS of the camera divided by the divisor of the host
+ */
+int QCCTV_LocalCamera::hostFps (const int host) const
+{
+    if (hostUsesMulticast (host))
+        return m_infoPacket->fps;
+
+    return m_infoPacket->fps / hostDivisor (host);
+}
+
+/**
+ * Returns the number of camera frames between two frames sent to the given
+ * \a host. The divisor is rounded up so that the host never receives more
+ * frames than the FPS that it asked for
+ */
+int QCCTV_LocalCamera::hostDivisor (const int host) const
+{
+    int requested = qMax (m_hosts.at (host).fps, 1);
+    return qMax ((m_infoPacket->fps + requested - 1) / requested, 1);
+}
+
+/**
+ * Returns the JPEG quality of the stream received by the given \a host, which
+ * is the quality that the host asked for or the limit that we set when the
+ * host was too slow. A value of 0 means that the automatic quality is used
+ */
+int QCCTV_LocalCamera::hostQuality (const int host) const
+{
+    if (m_hosts.at (host).quality > 0)
+        return m_hosts.at (host).quality;
+
+    return m_hosts.at (host).qualityLimit;
+}
+
+/**
+ * Returns the key of the stream rung that the given \a host is subscribed to
+ */
+int QCCTV_LocalCamera::hostRung (const int host) const
+{
+    if (hostUsesMulticast (host))
+        return multicastRung();
+
+    return QCCTV_RungKey (m_hosts.at (host).resolution,
+                          hostQuality (host),
+                          hostDivisor (host));
+}
+
+/**
+ * Returns the key of the stream rung sent to the multicast group, which uses
+ * the default resolution and the FPS of the camera
+ */
+int QCCTV_LocalCamera::multicastRung() const
+{
+    return QCCTV_RungKey (m_infoPacket->resolution, 0, 1);
+}
+
+/**
+ * Returns \c true if the given \a host receives the frames through the
+ * multicast group of the camera
+ */
+bool QCCTV_LocalCamera::hostUsesMulticast (const int host) const
+{
+    return m_multicastEnabled &&
+           (m_hosts.at (host).capabilities & QCCTV_CAPABILITY_MULTICAST);
+}
+
+/**
+ * Subscribes the given \a host to a stream with the given \a fps. The FPS
+ * of the camera itself is not changed
+ */
+void QCCTV_LocalCamera::setHostFps (const int host, const int fps)
+{
+    if (host < 0 || host >= m_hosts.count())
+        return;
+
+    if (m_hosts.at (host).fps != QCCTV_ValidFps (fps)) {
+        m_hosts [host].fps = QCCTV_ValidFps (fps);
+        m_hosts.at (host).watchdog->setExpirationTime (
+            QCCTV_GetWatchdogTime (hostFps (host)));
+
+        updateRungs();
+        requestKeyframe (host);
+    }
+}
+
+/**
+ * Subscribes the given \a host to a stream with the given JPEG \a quality,
+ * if \a quality is 0, the quality is selected by the rate controller
+ */
+void QCCTV_LocalCamera::setHostQuality (const int host, const int quality)
+{
+    if (host < 0 || host >= m_hosts.count())
+        return;
+
+    int value = 0;
+    if (quality > 0)
+        value = qMin (qMax (quality, QCCTV_MIN_QUALITY), QCCTV_MAX_QUALITY);
+
+    if (m_hosts.at (host).quality != value) {
+        m_hosts [host].quality = value;
+        m_hosts [host].qualityLimit = 0;
+        updateRungs();
+        requestKeyframe (host);
+    }
+}
+
+/**
+ * Subscribes the given \a host to the given \a resolution rung
+ */
+void QCCTV_LocalCamera::setHostResolution (const int host,
+                                           const int resolution)
+{
+    if (host < 0 || host >= m_hosts.count())
+        return;
+
+    if (m_hosts.at (host).resolution != resolution) {
+        m_hosts [host].resolution = resolution;
+        updateRungs();
+        requestKeyframe (host);
+    }
+}
+
 /**
  * Registers the given \a status flag to the operation status flags
  */
@@ -753,6 +1719,31 @@ QString QCCTV_LocalCamera::deviceName()
     return device;
 }
 
+/**
+ * Generates the packet that announces this camera to the stations, with the
+ * ports, codecs and resolutions that they need to connect to it
+ */
+QByteArray QCCTV_LocalCamera::announcePacket()
+{
+    QCCTV_AnnouncePacket packet;
+    packet.id = m_discoveryId;
+    packet.streamPort = m_server.serverPort();
+    packet.commandPort = m_cmdSocket.localPort();
+    packet.fps = fps();
+    packet.codec = codec();
+    packet.resolution = resolution();
+    packet.supportedCodecs = QCCTV_SupportedCodecs();
+    packet.supportedChecksums = QCCTV_SupportedChecksums();
+    packet.cameraName = name();
+    packet.cameraGroup = group();
+
+    foreach (QSharedPointer<QCCTV_StreamRung> rung, m_rungs)
+        if (!packet.rungs.contains (rung->resolution))
+            packet.rungs.append (rung->resolution);
+
+    return QCCTV_CreateAnnouncePacket (&packet);
+}
+
 /**
  * Returns the pointer to the stream packet structure
  */
@@ -23,22 +23,56 @@
 #ifndef _QCCTV_LOCAL_CAMERA_H
 #define _QCCTV_LOCAL_CAMERA_H
 
+#include <QMap>
 #include <QObject>
+#include <QTimer>
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QUdpSocket>
+#include <QVariantMap>
+#include <QVariantList>
+
+#include <QSharedPointer>
 
 #include <QCCTV.h>
+#include <QCCTV_RateController.h>
 
 class QCamera;
 class QCCTV_Watchdog;
+class QCCTV_FrameEncoder;
+class QCCTV_EncodedFrame;
 class QCCTV_ImageCapture;
 class QCameraImageCapture;
 
 struct QCCTV_InfoPacket;
+struct QCCTV_StreamRung;
 struct QCCTV_ImagePacket;
 struct QCCTV_CommandPacket;
 
+/**
+ * Subscription and flow control state of a station connected to the camera
+ */
+struct QCCTV_HostState {
+    QString name;
+    int fps;
+    int codecs;
+    int checksums;
+    int quality;
+    int qualityLimit;
+    int videoPort;
+    int resolution;
+    int capabilities;
+    int sentFrames;
+    int droppedFrames;
+    bool multiplexed;
+    bool waitingKeyframe;
+    quint32 commands;
+    QByteArray info;
+    QByteArray buffer;
+    QCCTV_Watchdog* watchdog;
+    QSharedPointer<const QCCTV_EncodedFrame> pendingFrame;
+};
+
 class QCCTV_LocalCamera : public QObject
 {
     Q_OBJECT
@@ -46,6 +80,17 @@ class QCCTV_LocalCamera : public QObject
                 READ fps
                 WRITE setFPS
                 NOTIFY fpsChanged)
+    Q_PROPERTY (int bitrate
+                READ bitrate
+                WRITE setBitrate
+                NOTIFY bitrateChanged)
+    Q_PROPERTY (int quality
+                READ quality
+                NOTIFY qualityChanged)
+    Q_PROPERTY (int codec
+                READ codec
+                WRITE setCodec
+                NOTIFY codecChanged)
     Q_PROPERTY (QString name
                 READ name
                 WRITE setName
@@ -66,10 +111,18 @@ class QCCTV_LocalCamera : public QObject
                 READ flashlightEnabled
                 WRITE setFlashlightEnabled
                 NOTIFY lightStatusChanged)
+    Q_PROPERTY (bool deltaEncoding
+                READ deltaEncoding
+                WRITE setDeltaEncoding
+                NOTIFY deltaEncodingChanged)
     Q_PROPERTY (bool autoRegulateResolution
                 READ autoRegulateResolution
                 WRITE setAutoRegulateResolution
                 NOTIFY autoRegulateResolutionChanged)
+    Q_PROPERTY (bool multicastEnabled
+                READ multicastEnabled
+                WRITE setMulticastEnabled
+                NOTIFY multicastEnabledChanged)
     Q_PROPERTY (int minimumFps
                 READ minimumFPS
                 CONSTANT)
@@ -104,6 +157,9 @@ class QCCTV_LocalCamera : public QObject
 Q_SIGNALS:
     void fpsChanged();
     void nameChanged();
+    void codecChanged();
+    void bitrateChanged();
+    void qualityChanged();
     void imageChanged();
     void groupChanged();
     void cameraChanged();
@@ -114,7 +170,9 @@ Q_SIGNALS:
     void lightStatusChanged();
     void focusStatusChanged();
     void supportsZoomChanged();
+    void deltaEncodingChanged();
     void cameraStatusChanged();
+    void multicastEnabledChanged();
     void autoRegulateResolutionChanged();
 
 public:
@@ -122,6 +180,9 @@ public:
     ~QCCTV_LocalCamera();
 
     int fps();
+    int codec();
+    int bitrate();
+    int quality();
     QString name();
     QString group();
     int zoomLevel();
@@ -130,6 +191,8 @@ public:
     bool supportsZoom();
     QImage currentImage();
     QString statusString();
+    bool deltaEncoding();
+    bool multicastEnabled();
     int flashlightEnabled();
     bool autoRegulateResolution();
 
@@ -140,16 +203,22 @@ public:
     QStringList hostNames() const;
     QStringList connectedHosts() const;
     QStringList availableResolutions() const;
+    Q_INVOKABLE QVariantMap pipelineStats() const;
+    Q_INVOKABLE QVariantList clientStats() const;
 
 public Q_SLOTS:
     void takePhoto();
     void focusCamera();
     void setFPS (const int fps);
+    void setCodec (const int codec);
+    void setBitrate (const int bitrate);
     void setCamera (QCamera* camera);
     void setName (const QString& name);
     void setZoomLevel (const int level);
     void setGroup (const QString& group);
     void setResolution (const int resolution);
+    void setDeltaEncoding (const bool enabled);
+    void setMulticastEnabled (const bool enabled);
     void setFlashlightEnabled (const bool enabled);
     void setAutoRegulateResolution (const bool regulate);
 
@@ -158,20 +227,43 @@ private Q_SLOTS:
     void sendInfo();
     void sendImage();
     void changeImage();
+    void onImageEncoded();
+    void answerProbes();
     void broadcastInfo();
     void onDisconnected();
     void acceptConnection();
+    void readProbePacket();
     void readCommandPacket();
     void onWatchdogTimeout();
+    void onStreamDataReceived();
     void onBytesWritten (const qint64 bytes);
 
 private:
+    void updateCodec();
+    void updateChecksum();
+    void updateBudget();
     void updateStatus();
+    void updateRungs();
+    void updateQuality();
+    int hostFps (const int host) const;
+    int hostRung (const int host) const;
+    int hostQuality (const int host) const;
+    int hostDivisor (const int host) const;
+    int multicastRung() const;
+    bool hostUsesMulticast (const int host) const;
+    void requestKeyframe (const int host);
+    void recoverHost (const int host, const quint32 sequence);
+    void applyCommands (const int host);
+    void readCommand (const int index, const QByteArray& data);
+    void setHostFps (const int host, const int fps);
+    void setHostQuality (const int host, const int quality);
+    void setHostResolution (const int host, const int resolution);
     void addStatusFlag (const int status);
     void setCameraStatus (const int status);
     void removeStatusFlag (const int status);
 
     QString deviceName();
+    QByteArray announcePacket();
     QCCTV_InfoPacket* infoPacket();
     QCCTV_ImagePacket* imagePacket();
     QCCTV_CommandPacket* commandPacket();
@@ -183,15 +275,33 @@ private:
     QTcpServer m_server;
     QUdpSocket m_cmdSocket;
     QUdpSocket m_infoSocket;
+    QUdpSocket m_videoSocket;
+    QUdpSocket m_probeSocket;
     QUdpSocket m_broadcastSocket;
 
-    QByteArray m_data;
+    QTimer m_beaconTimer;
+    int m_beaconInterval;
+    quint32 m_discoveryId;
+    QList<QHostAddress> m_probeReplies;
+
+    int m_codec;
+    int m_frameLatency;
+    bool m_deltaEncoding;
+    bool m_multicastEnabled;
+    QHostAddress m_multicastGroup;
+
+    quint32 m_infoVersion;
+    qint64 m_lastHeartbeat;
 
-    QStringList m_hostNames;
     QList<QTcpSocket*> m_sockets;
-    QList<QCCTV_Watchdog*> m_watchdogs;
+    QList<QCCTV_HostState> m_hosts;
 
+    QImage m_preview;
+    QMap<int, QSharedPointer<const QCCTV_EncodedFrame> > m_frames;
+    QCCTV_FrameEncoder* m_encoder;
     QCCTV_ImageCapture* m_imageCapture;
+    QCCTV_RateController m_rateController;
+    QMap<int, QSharedPointer<QCCTV_StreamRung> > m_rungs;
 
     QCCTV_InfoPacket* m_infoPacket;
     QCCTV_ImagePacket* m_imagePacket;
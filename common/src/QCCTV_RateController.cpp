@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include <cmath>
+
+#include "QCCTV.h"
+#include "QCCTV_RateController.h"
+
+/*
+ * Do not change the quality if the average frame size is within ~7% of the
+ * budget, this avoids oscillating between two quality levels
+ */
+static const double DEADBAND = 0.1;
+
+QCCTV_RateController::QCCTV_RateController()
+{
+    m_budget = 0;
+    reset();
+}
+
+/**
+ * Returns the maximum number of bytes that a frame should have, a value of
+ * \c 0 means that there is no limit
+ */
+int QCCTV_RateController::budget() const
+{
+    return m_budget;
+}
+
+/**
+ * Returns the JPEG quality that should be used to encode the next frame
+ */
+int QCCTV_RateController::quality() const
+{
+    return m_quality;
+}
+
+/**
+ * Returns \c true if a bytes-per-frame budget has been set
+ */
+bool QCCTV_RateController::isLimited() const
+{
+    return m_budget > 0;
+}
+
+/**
+ * Forgets the sizes of the previous frames and restores the maximum quality
+ */
+void QCCTV_RateController::reset()
+{
+    m_average = 0;
+    m_quality = QCCTV_MAX_QUALITY;
+}
+
+/**
+ * Registers the size (in \a bytes) of the last encoded frame and updates the
+ * quality that shall be used for the next frame
+ */
+void QCCTV_RateController::addFrame (const int bytes)
+{
+    /* No budget, slowly go back to the maximum quality */
+    if (!isLimited()) {
+        m_quality = qMin (QCCTV_MAX_QUALITY, m_quality + 1);
+        return;
+    }
+
+    /* Update the average frame size */
+    if (m_average <= 0)
+        m_average = bytes;
+    else
+        m_average = (m_average + bytes) / 2;
+
+    /* Get the error in a log scale (JPEG sizes grow exponentially with q.) */
+    const double error = std::log (m_average / m_budget) / std::log (2.0);
+    if (std::fabs (error) < DEADBAND)
+        return;
+
+    /* Lower the quality quickly and raise it slowly */
+    const int step = qBound (-5, (int) std::floor (error * 16 + 0.5), 15);
+    m_quality = qBound (QCCTV_MIN_QUALITY, m_quality - step, QCCTV_MAX_QUALITY);
+}
+
+/**
+ * Changes the maximum number of \a bytes that a frame should have, a value of
+ * \c 0 disables rate control
+ */
+void QCCTV_RateController::setBudget (const int bytes)
+{
+    if (m_budget != qMax (bytes, 0)) {
+        m_budget = qMax (bytes, 0);
+        m_average = 0;
+    }
+}
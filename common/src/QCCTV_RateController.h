@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_RATE_CONTROLLER_H
+#define _QCCTV_RATE_CONTROLLER_H
+
+/**
+ * \brief Adjusts the JPEG quality so that the encoded frames fit in a given
+ *        bytes-per-frame budget.
+ *
+ * The controller keeps a running average of the sizes of the last frames
+ * and changes the quality of the next frame depending on how far that average
+ * is from the budget. Quality is lowered quickly and raised slowly, so that
+ * the stream settles below the budget.
+ */
+class QCCTV_RateController
+{
+public:
+    explicit QCCTV_RateController();
+
+    int budget() const;
+    int quality() const;
+    bool isLimited() const;
+
+    void reset();
+    void addFrame (const int bytes);
+    void setBudget (const int bytes);
+
+private:
+    int m_budget;
+    int m_quality;
+    double m_average;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#include "QCCTV_ReceiveBuffer.h"
+
+#include <QIODevice>
+
+#include <string.h>
+
+QCCTV_ReceiveBuffer::QCCTV_ReceiveBuffer (const int capacity)
+{
+    m_begin = 0;
+    m_end = 0;
+    m_buffer.resize (capacity);
+}
+
+/**
+ * Returns the number of received bytes that have not been consumed yet
+ */
+int QCCTV_ReceiveBuffer::size() const
+{
+    return m_end - m_begin;
+}
+
+/**
+ * Returns the maximum number of bytes that the buffer can hold
+ */
+int QCCTV_ReceiveBuffer::capacity() const
+{
+    return m_buffer.size();
+}
+
+/**
+ * Returns a pointer to the first byte that has not been consumed yet
+ */
+const char* QCCTV_ReceiveBuffer::data() const
+{
+    return m_buffer.constData() + m_begin;
+}
+
+/**
+ * Returns a non-owning view of the first \a length bytes that have not been
+ * consumed yet. The view is only valid until the next call to \c readFrom()
+ */
+QByteArray QCCTV_ReceiveBuffer::view (const int length) const
+{
+    return QByteArray::fromRawData (data(), qMin (length, size()));
+}
+
+/**
+ * Discards the received data without releasing the buffer
+ */
+void QCCTV_ReceiveBuffer::clear()
+{
+    m_begin = 0;
+    m_end = 0;
+}
+
+/**
+ * Marks the first \a bytes of the received data as consumed
+ */
+void QCCTV_ReceiveBuffer::consume (const int bytes)
+{
+    m_begin += qMin (qMax (bytes, 0), size());
+
+    if (m_begin == m_end)
+        clear();
+}
+
+/**
+ * Reads the available data of the given \a device directly into the free
+ * space of the buffer. Returns the number of bytes read, which is \c 0 if
+ * the device has no data or if the buffer is full
+ */
+qint64 QCCTV_ReceiveBuffer::readFrom (QIODevice* device)
+{
+    if (!device)
+        return 0;
+
+    if (m_end == capacity())
+        compact();
+
+    const qint64 bytes = device->read (m_buffer.data() + m_end,
+                                       capacity() - m_end);
+    if (bytes <= 0)
+        return 0;
+
+    m_end += bytes;
+    return bytes;
+}
+
+/**
+ * Moves the data that has not been consumed yet to the start of the buffer
+ */
+void QCCTV_ReceiveBuffer::compact()
+{
+    if (m_begin > 0) {
+        memmove (m_buffer.data(), m_buffer.constData() + m_begin, size());
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+#ifndef _QCCTV_RECEIVE_BUFFER_H
+#define _QCCTV_RECEIVE_BUFFER_H
+
+#include <QByteArray>
+
+class QIODevice;
+
+/**
+ * \brief Reusable buffer in which the stream socket writes the received data
+ *
+ * The buffer is allocated once, the socket reads directly into its free
+ * space and the frames are parsed in place. Consumed data is not moved until
+ * the buffer runs out of space at its end, and then only the bytes of the
+ * incomplete frame are moved to the start of the buffer.
+ */
+class QCCTV_ReceiveBuffer
+{
+public:
+    explicit QCCTV_ReceiveBuffer (const int capacity);
+
+    int size() const;
+    int capacity() const;
+    const char* data() const;
+    QByteArray view (const int length) const;
+
+    void clear();
+    void consume (const int bytes);
+    qint64 readFrom (QIODevice* device);
+
+private:
+    void compact();
+
+private:
+    int m_begin;
+    int m_end;
+    QByteArray m_buffer;
+};
+
+#endif
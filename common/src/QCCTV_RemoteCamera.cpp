@@ -41,10 +41,32 @@ static const QString hostName()
     return host;
 }
 
-QCCTV_RemoteCamera::QCCTV_RemoteCamera (QObject* parent) : QObject (parent)
+QCCTV_RemoteCamera::QCCTV_RemoteCamera (QObject* parent) : QObject (parent),
+    m_buffer (QCCTV_RECEIVE_BUFFER_SIZE)
 {
     m_id = 0;
+    m_sequence = 0;
+    m_keyframeSequence = 0;
+    m_checkedBytes = 0;
+    m_socket = Q_NULLPTR;
+    m_watchdog = Q_NULLPTR;
+    m_videoSocket = Q_NULLPTR;
+    m_commandSocket = Q_NULLPTR;
+    m_multicastSocket = Q_NULLPTR;
+    m_transport = QCCTV_TRANSPORT_TCP;
     m_connected = false;
+    m_hasReference = false;
+    m_multicastFailed = false;
+    m_infoVersion = -1;
+    m_discoveryId = -1;
+    m_streamPort = QCCTV_STREAM_PORT;
+    m_commandPort = QCCTV_COMMAND_PORT;
+    m_retryScheduled = false;
+    m_reconnectScheduled = false;
+    m_reconnectAttempts = 0;
+    m_commandScheduled = false;
+    m_pendingFields = 0;
+    m_multiplexed = false;
     m_saveIncomingMedia = false;
     m_saver = new QCCTV_ImageSaver (this);
     m_infoPacket = new QCCTV_InfoPacket;
@@ -74,6 +96,16 @@ QCCTV_RemoteCamera::~QCCTV_RemoteCamera()
         delete m_commandSocket;
     }
 
+    if (m_videoSocket) {
+        m_videoSocket->close();
+        delete m_videoSocket;
+    }
+
+    if (m_multicastSocket) {
+        m_multicastSocket->close();
+        delete m_multicastSocket;
+    }
+
     if (m_watchdog)
         delete m_watchdog;
 
@@ -83,11 +115,21 @@ QCCTV_RemoteCamera::~QCCTV_RemoteCamera()
     delete m_commandPacket;
 }
 
+/**
+ * Returns the transport used to receive the frames of the camera
+ */
+int QCCTV_RemoteCamera::transport()
+{
+    QMutexLocker lock (&m_mutex);
+    return m_transport;
+}
+
 /**
  * Returns the FPS set by the station or by the camera itself
  */
 int QCCTV_RemoteCamera::fps()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->fps;
 }
 
@@ -96,6 +138,7 @@ int QCCTV_RemoteCamera::fps()
  */
 int QCCTV_RemoteCamera::zoom()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->zoom;
 }
 
@@ -104,14 +147,34 @@ int QCCTV_RemoteCamera::zoom()
  */
 int QCCTV_RemoteCamera::status()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->cameraStatus;
 }
 
+/**
+ * Returns the maximum bitrate (in kbps) assigned to the camera stream
+ */
+int QCCTV_RemoteCamera::bitrate()
+{
+    QMutexLocker lock (&m_mutex);
+    return infoPacket()->bitrate;
+}
+
+/**
+ * Returns the JPEG quality currently used by the camera
+ */
+int QCCTV_RemoteCamera::quality()
+{
+    QMutexLocker lock (&m_mutex);
+    return infoPacket()->quality;
+}
+
 /**
  * Returns the latest image captured by the camera
  */
 QImage QCCTV_RemoteCamera::image()
 {
+    QMutexLocker lock (&m_mutex);
     return imagePacket()->image;
 }
 
@@ -120,6 +183,7 @@ QImage QCCTV_RemoteCamera::image()
  */
 QString QCCTV_RemoteCamera::name()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->cameraName;
 }
 
@@ -128,6 +192,7 @@ QString QCCTV_RemoteCamera::name()
  */
 QString QCCTV_RemoteCamera::group()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->cameraGroup;
 }
 
@@ -136,6 +201,7 @@ QString QCCTV_RemoteCamera::group()
  */
 int QCCTV_RemoteCamera::resolution()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->resolution;
 }
 
@@ -144,6 +210,7 @@ int QCCTV_RemoteCamera::resolution()
  */
 bool QCCTV_RemoteCamera::supportsZoom()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->supportsZoom;
 }
 
@@ -160,6 +227,7 @@ QString QCCTV_RemoteCamera::statusString()
  */
 bool QCCTV_RemoteCamera::flashlightEnabled()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->flashlightEnabled;
 }
 
@@ -168,6 +236,7 @@ bool QCCTV_RemoteCamera::flashlightEnabled()
  */
 bool QCCTV_RemoteCamera::autoRegulateResolution()
 {
+    QMutexLocker lock (&m_mutex);
     return infoPacket()->autoRegulateResolution;
 }
 
@@ -185,6 +254,7 @@ int QCCTV_RemoteCamera::id() const
  */
 bool QCCTV_RemoteCamera::isConnected() const
 {
+    QMutexLocker lock (&m_mutex);
     return m_connected;
 }
 
@@ -196,6 +266,84 @@ QHostAddress QCCTV_RemoteCamera::address() const
     return m_address;
 }
 
+/**
+ * Returns the ID announced by the camera, or \c -1 if we found the camera
+ * through the beacon of an older version of QCCTV
+ */
+qint64 QCCTV_RemoteCamera::discoveryId() const
+{
+    QMutexLocker lock (&m_mutex);
+    return m_discoveryId;
+}
+
+/**
+ * Returns the resolutions that the camera was already encoding when it
+ * announced itself, selecting one of them does not add any encoding work
+ * to the camera
+ */
+QList<int> QCCTV_RemoteCamera::streamResolutions() const
+{
+    QMutexLocker lock (&m_mutex);
+    return m_streamResolutions;
+}
+
+/**
+ * Returns an announcement with the ports, name and the last resolution of the
+ * camera, which the station stores to reconnect to the camera on startup
+ * without waiting for it to announce itself again.
+ *
+ * \note This function must be called from the thread of the camera, which is
+ *       the only thread that changes the announced values
+ */
+QByteArray QCCTV_RemoteCamera::announcement()
+{
+    QCCTV_AnnouncePacket packet;
+    packet.id = (quint32) qMax (m_discoveryId, (qint64) 0);
+    packet.streamPort = m_streamPort;
+    packet.commandPort = m_commandPort;
+    packet.fps = infoPacket()->fps;
+    packet.codec = infoPacket()->codec;
+    packet.resolution = infoPacket()->resolution;
+    packet.supportedCodecs = infoPacket()->supportedCodecs;
+    packet.supportedChecksums = infoPacket()->supportedChecksums;
+    packet.rungs = m_streamResolutions;
+    packet.cameraName = infoPacket()->cameraName;
+    packet.cameraGroup = infoPacket()->cameraGroup;
+
+    return QCCTV_CreateAnnouncePacket (&packet);
+}
+
+/**
+ * Applies the ports and settings announced by the camera, this function
+ * must be called before \c start(), so that we connect to the camera and
+ * display its name and group without waiting for its first info packet
+ */
+void QCCTV_RemoteCamera::readAnnouncement (const QCCTV_AnnouncePacket& packet)
+{
+    updateEndpoint (packet);
+
+    infoPacket()->fps = packet.fps;
+    infoPacket()->codec = packet.codec;
+    infoPacket()->resolution = packet.resolution;
+    infoPacket()->cameraName = packet.cameraName;
+    infoPacket()->cameraGroup = packet.cameraGroup;
+    infoPacket()->supportedCodecs = packet.supportedCodecs;
+    infoPacket()->supportedChecksums = packet.supportedChecksums;
+
+    commandPacket()->fps = packet.fps;
+    commandPacket()->resolution = packet.resolution;
+}
+
+/**
+ * Returns \c true if the command packets are sent through the stream
+ * connection, in which case the camera sends its info packets through the
+ * stream connection too
+ */
+bool QCCTV_RemoteCamera::multiplexed() const
+{
+    return m_multiplexed;
+}
+
 /**
  * Returns \c true if the class shall save to the disk the received images
  */
@@ -225,30 +373,69 @@ void QCCTV_RemoteCamera::start()
 
     /* Initialize sockets */
     m_socket = new QTcpSocket (this);
+    m_videoSocket = new QUdpSocket (this);
     m_commandSocket = new QUdpSocket (this);
+    m_multicastSocket = new QUdpSocket (this);
+
+    /* Open an UDP port to receive frames if the UDP transport is selected */
+    m_videoSocket->bind (QHostAddress::AnyIPv4, 0);
+    connect (m_videoSocket, SIGNAL (readyRead()),
+             this,            SLOT (onVideoDatagramReceived()));
+    connect (m_multicastSocket, SIGNAL (readyRead()),
+             this,                SLOT (onVideoDatagramReceived()));
+    updateVideoPort();
 
     /* Configure signals/slots */
     connect (m_socket,     SIGNAL (readyRead()),
              this,           SLOT (onImageDataReceived()));
     connect (m_socket,     SIGNAL (disconnected()),
              this,           SLOT (endConnection()));
+    connect (m_socket,     SIGNAL (error (QAbstractSocket::SocketError)),
+             this,           SLOT (scheduleReconnect()));
 
     /* Connect to camera */
-    m_socket->connectToHost (m_address, QCCTV_STREAM_PORT);
+    m_socket->connectToHost (m_address, m_streamPort);
     m_socket->setSocketOption (QTcpSocket::LowDelayOption, 1);
     m_socket->setSocketOption (QTcpSocket::KeepAliveOption, 1);
 }
 
 /**
- * Instructs the class to generate a packet that requests the camera to perform
- * a forced focus.
+ * Resets the reconnection interval and opens a new connection with the
+ * camera immediately, this is used when the camera announces itself again
+ * while we are waiting to reconnect to it
  *
- * The focus byte will be reset after sending some packets to the camera
+ * \note This function has no effect if we are already connected (or trying
+ *       to connect) to the camera
+ */
+void QCCTV_RemoteCamera::reconnect()
+{
+    m_reconnectAttempts = 0;
+    retryConnection();
+}
+
+/**
+ * Opens a new connection with the camera, the ID, settings and last image of
+ * the camera are kept, so that the station does not need to register the
+ * camera again after a network hiccup
+ */
+void QCCTV_RemoteCamera::retryConnection()
+{
+    m_reconnectScheduled = false;
+
+    if (!m_socket || m_socket->state() != QAbstractSocket::UnconnectedState)
+        return;
+
+    m_infoVersion = -1;
+    m_hasReference = false;
+    m_socket->connectToHost (m_address, m_streamPort);
+}
+
+/**
+ * Requests the camera to perform a forced focus
  */
 void QCCTV_RemoteCamera::requestFocus()
 {
-    m_commandPacket->focusRequest = true;
-    QTimer::singleShot (500, this, SLOT (resetFocusRequest()));
+    issueCommand (QCCTV_COMMAND_FOCUS);
 }
 
 /**
@@ -260,12 +447,14 @@ void QCCTV_RemoteCamera::changeID (const int id)
 }
 
 /**
- * Updates the FPS value reported (or assigned) by the camera
+ * Subscribes this station to a stream with the given \a fps, the camera
+ * keeps capturing at its own FPS and sends us only some of its frames
  */
 void QCCTV_RemoteCamera::changeFPS (const int fps)
 {
     int validFps = QCCTV_ValidFps (fps);
-    commandPacket()->newFps = validFps;
+    commandPacket()->fps = validFps;
+    issueCommand (QCCTV_COMMAND_FPS);
 
     if (m_watchdog)
         m_watchdog->setExpirationTime (QCCTV_GetWatchdogTime (validFps));
@@ -276,7 +465,71 @@ void QCCTV_RemoteCamera::changeFPS (const int fps)
  */
 void QCCTV_RemoteCamera::changeZoom (const int zoom)
 {
-    commandPacket()->newZoom = qMin (qMax (zoom, 0), 100);
+    commandPacket()->zoom = qMin (qMax (zoom, 0), 100);
+    issueCommand (QCCTV_COMMAND_ZOOM);
+}
+
+/**
+ * Changes the maximum bitrate (in kbps) of the camera stream, the camera
+ * shall adjust its JPEG quality to stay within this budget
+ */
+void QCCTV_RemoteCamera::changeBitrate (const int bitrate)
+{
+    commandPacket()->bitrate = qMax (bitrate, 0);
+    issueCommand (QCCTV_COMMAND_BITRATE);
+}
+
+/**
+ * Subscribes this station to a stream with the given JPEG \a quality, if
+ * \a quality is 0, the camera selects the quality with its rate controller
+ */
+void QCCTV_RemoteCamera::changeQuality (const int quality)
+{
+    if (quality <= 0)
+        commandPacket()->quality = 0;
+    else
+        commandPacket()->quality = qMin (qMax (quality, QCCTV_MIN_QUALITY),
+                                         QCCTV_MAX_QUALITY);
+
+    issueCommand (0);
+}
+
+/**
+ * Selects the \a transport used to receive the frames of the camera. With
+ * the UDP transport, frames that lose a datagram are dropped instead of
+ * stalling the stream. If no frames arrive through UDP, the station falls
+ * back to TCP automatically.
+ *
+ * The multicast transport is selected automatically when the camera
+ * advertises a multicast group
+ */
+void QCCTV_RemoteCamera::changeTransport (const int transport)
+{
+    if (m_transport != transport) {
+        /* Leave the multicast group */
+        if (m_transport == QCCTV_TRANSPORT_MULTICAST && m_multicastSocket) {
+            m_multicastSocket->leaveMulticastGroup (m_multicastGroup);
+            m_multicastSocket->close();
+        }
+
+        m_mutex.lock();
+        m_transport = transport;
+        m_mutex.unlock();
+
+        m_partialFrames.clear();
+        updateVideoPort();
+        issueCommand (0);
+        emit transportChanged (id());
+    }
+}
+
+/**
+ * Enables or disables sending the command packets through the stream
+ * connection instead of the UDP command socket
+ */
+void QCCTV_RemoteCamera::setMultiplexed (const bool multiplexed)
+{
+    m_multiplexed = multiplexed;
 }
 
 /**
@@ -288,31 +541,60 @@ void QCCTV_RemoteCamera::setSaveIncomingMedia (const bool save)
 }
 
 /**
- * Reads and interprets an information packet coming from the camera
+ * Reads and interprets an information packet coming from the camera. Packets
+ * with the same version as the last packet are only acknowledged, since the
+ * camera information did not change.
+ *
+ * This function runs in the thread of the camera, while the station reads the
+ * camera information from its own thread, so the information is only written
+ * while holding the mutex of the camera
  */
 void QCCTV_RemoteCamera::readInfoPacket (const QByteArray& data)
 {
+    quint32 version;
+    if (QCCTV_ReadInfoVersion (&version, data) && version == m_infoVersion) {
+        acknowledgeReception();
+        return;
+    }
+
     QCCTV_InfoPacket packet;
     if (QCCTV_ReadInfoPacket (&packet, data)) {
+        m_infoVersion = packet.version;
+
+        /* Camera applied the commands that we sent (not the pending ones) */
+        if (packet.commandAck == commandPacket()->sequence)
+            commandPacket()->fields = 0;
+
+        m_mutex.lock();
+        infoPacket()->codec = packet.codec;
+        infoPacket()->supportedCodecs = packet.supportedCodecs;
+        infoPacket()->checksum = packet.checksum;
+        infoPacket()->supportedChecksums = packet.supportedChecksums;
+        m_mutex.unlock();
+
         updateFPS (packet.fps);
         updateZoom (packet.zoom);
         updateName (packet.cameraName);
         updateGroup (packet.cameraGroup);
         updateStatus (packet.cameraStatus);
+        updateBitrate (packet.bitrate);
+        updateQuality (packet.quality);
         updateResolution (packet.resolution);
         updateZoomSupport (packet.supportsZoom);
         updateAutoRegulate (packet.autoRegulateResolution);
         updateFlashlightEnabled (packet.flashlightEnabled);
+        joinMulticastGroup (packet.multicastGroup, packet.multicastPort);
         acknowledgeReception();
     }
 }
 
 /**
- * Changes the resoltion of the camera
+ * Subscribes this station to a stream with the given \a resolution
  */
 void QCCTV_RemoteCamera::changeResolution (const int resolution)
 {
-    commandPacket()->newResolution = resolution;
+    commandPacket()->resolution = resolution;
+    issueCommand (QCCTV_COMMAND_RESOLUTION);
 }
 
 /**
@@ -327,12 +609,28 @@ void QCCTV_RemoteCamera::setAddress (const QHostAddress& address)
     m_address = address;
 }
 
+/**
+ * Reads an \a announcement sent by the camera after we registered it. If the
+ * camera was restarted, its discovery ID (and maybe its ports) changed, so
+ * we update them to reconnect to the right ports and to recognize the next
+ * announcements of the camera
+ */
+void QCCTV_RemoteCamera::updateAnnouncement (const QByteArray& announcement)
+{
+    QCCTV_AnnouncePacket packet;
+    if (QCCTV_ReadAnnouncePacket (&packet, announcement)) {
+        updateEndpoint (packet);
+        publishAnnouncement();
+    }
+}
+
 /**
  * Allows or disallows the camera from autoregulating its resolution
  */
 void QCCTV_RemoteCamera::changeAutoRegulate (const bool regulate)
 {
-    commandPacket()->newAutoRegulateResolution = regulate;
+    commandPacket()->autoRegulateResolution = regulate;
+    issueCommand (QCCTV_COMMAND_AUTOREGRES);
 }
 
 /**
@@ -340,7 +638,8 @@ void QCCTV_RemoteCamera::changeAutoRegulate (const bool regulate)
  */
 void QCCTV_RemoteCamera::changeFlashlightStatus (const int status)
 {
-    commandPacket()->newFlashlightEnabled = status;
+    commandPacket()->flashlightEnabled = status;
+    issueCommand (QCCTV_COMMAND_FLASHLIGHT);
 }
 
 /**
@@ -361,10 +660,23 @@ void QCCTV_RemoteCamera::setIncomingMediaPath (const QString& path)
  *
  * Also, this function is called when the class successfully reads a stream
  * packet from the remote camera.
+ *
+ * If we were using the UDP transport, we switch back to TCP, since we did not
+ * receive any complete frame through UDP during the watchdog period. The same
+ * happens with the multicast transport, in which case we do not try to join
+ * the group again, since the network probably does not route it.
  */
 void QCCTV_RemoteCamera::clearBuffer()
 {
-    m_data.clear();
+    m_buffer.clear();
+    m_checkedBytes = 0;
+    m_partialFrames.clear();
+
+    if (m_transport == QCCTV_TRANSPORT_MULTICAST)
+        m_multicastFailed = true;
+
+    if (m_transport != QCCTV_TRANSPORT_TCP)
+        changeTransport (QCCTV_TRANSPORT_TCP);
 }
 
 /**
@@ -381,15 +693,69 @@ void QCCTV_RemoteCamera::endConnection()
     clearBuffer();
     updateConnected (false);
     emit disconnected (id());
+    scheduleReconnect();
+}
+
+/**
+ * Tries to connect to the camera again after an interval that doubles with
+ * every failed attempt. If the camera does not answer after
+ * \c QCCTV_RECONNECT_ATTEMPTS attempts, we tell the station to forget it
+ */
+void QCCTV_RemoteCamera::scheduleReconnect()
+{
+    if (m_reconnectScheduled)
+        return;
+
+    if (m_reconnectAttempts >= QCCTV_RECONNECT_ATTEMPTS) {
+        m_reconnectScheduled = true;
+        emit unreachable (id());
+        return;
+    }
+
+    const int interval = qMin (QCCTV_RECONNECT_INTERVAL << m_reconnectAttempts,
+                               QCCTV_RECONNECT_MAX_INTERVAL);
+
+    m_reconnectAttempts += 1;
+    m_reconnectScheduled = true;
+    QTimer::singleShot (interval, this, SLOT (retryConnection()));
+}
+
+/**
+ * Sends the commands issued during the last \c QCCTV_COMMAND_COALESCE
+ * milliseconds with a new sequence number, together with the commands that
+ * the camera did not acknowledge yet. The commands are re-sent until the
+ * camera acknowledges them
+ */
+void QCCTV_RemoteCamera::flushCommands()
+{
+    m_commandScheduled = false;
+    commandPacket()->fields |= m_pendingFields;
+    commandPacket()->sequence += 1;
+    m_pendingFields = 0;
+    sendCommandPacket();
+
+    if (!m_retryScheduled && commandPacket()->fields != 0) {
+        m_retryScheduled = true;
+        QTimer::singleShot (QCCTV_COMMAND_RETRY, Qt::PreciseTimer,
+                            this, SLOT (retransmitCommands()));
+    }
 }
 
 /**
- * Disables the focus flag. This function is called after 3 command packets
- * instructing the camera to re-focus itself have been sent.
+ * Re-sends the commands that the camera did not acknowledge yet, this does
+ * not depend on the camera sending us any frames
  */
-void QCCTV_RemoteCamera::resetFocusRequest()
+void QCCTV_RemoteCamera::retransmitCommands()
 {
-    commandPacket()->focusRequest = false;
+    m_retryScheduled = false;
+
+    if (commandPacket()->fields != 0 && m_socket &&
+        m_socket->state() == QAbstractSocket::ConnectedState) {
+        sendCommandPacket();
+        m_retryScheduled = true;
+        QTimer::singleShot (QCCTV_COMMAND_RETRY, Qt::PreciseTimer,
+                            this, SLOT (retransmitCommands()));
+    }
 }
 
 /**
@@ -403,18 +769,30 @@ void QCCTV_RemoteCamera::onImageDataReceived()
         return;
     }
 
-    else {
-        m_data.append (m_socket->readAll());
+    /* Read directly into the receive buffer, and parse the frames in place */
+    while (m_buffer.readFrom (m_socket) > 0)
+        readImagePacket();
+}
+
+/**
+ * Reads all the datagrams received by the UDP video socket or by the
+ * multicast socket
+ */
+void QCCTV_RemoteCamera::onVideoDatagramReceived()
+{
+    QUdpSocket* socket = qobject_cast<QUdpSocket*> (sender());
 
-        if (!m_data.isEmpty())
-            readImagePacket();
+    while (socket && socket->hasPendingDatagrams()) {
+        QByteArray data;
+        QHostAddress address;
+        data.resize (socket->pendingDatagramSize());
+        socket->readDatagram (data.data(), data.size(), &address);
 
-        if (m_data.size() >= QCCTV_MAX_BUFFER_SIZE)
-            clearBuffer();
+        if (address.toIPv4Address() == m_address.toIPv4Address())
+            readDatagram (data);
     }
 }
 
-
 /**
  * Sends a command packet to the camera, which instructs it to:
  *
@@ -424,10 +802,21 @@ void QCCTV_RemoteCamera::onImageDataReceived()
  */
 void QCCTV_RemoteCamera::sendCommandPacket()
 {
-    QByteArray data = QCCTV_CreateCommandPacket (commandPacket());
+    char buffer [QCCTV_PACKET_MAX_SIZE];
+    const int length = QCCTV_WriteCommandPacket (commandPacket(), buffer,
+                                                 sizeof (buffer));
+
+    if (length <= 0)
+        return;
+
+    if (multiplexed() && m_socket &&
+        m_socket->state() == QAbstractSocket::ConnectedState)
+        m_socket->write (QCCTV_CreateChannelPacket (QCCTV_CHANNEL_COMMAND,
+                                                    buffer, length));
 
-    if (m_commandSocket)
-        m_commandSocket->writeDatagram (data, address(), QCCTV_COMMAND_PORT);
+    else if (m_commandSocket)
+        m_commandSocket->writeDatagram (buffer, length, address(),
+                                        m_commandPort);
 }
 
 /**
@@ -436,9 +825,10 @@ void QCCTV_RemoteCamera::sendCommandPacket()
 void QCCTV_RemoteCamera::updateFPS (const int fps)
 {
     if (infoPacket()->fps != fps) {
+        m_mutex.lock();
         infoPacket()->fps = fps;
-        commandPacket()->oldFps = fps;
-        commandPacket()->newFps = fps;
+        m_mutex.unlock();
+
         emit fpsChanged (id());
     }
 }
@@ -449,9 +839,10 @@ void QCCTV_RemoteCamera::updateFPS (const int fps)
 void QCCTV_RemoteCamera::updateZoom (const int zoom)
 {
     if (infoPacket()->zoom != zoom) {
+        m_mutex.lock();
         infoPacket()->zoom = zoom;
-        commandPacket()->oldZoom = zoom;
-        commandPacket()->newZoom = zoom;
+        m_mutex.unlock();
+
         emit zoomLevelChanged (id());
     }
 }
@@ -462,20 +853,53 @@ void QCCTV_RemoteCamera::updateZoom (const int zoom)
 void QCCTV_RemoteCamera::updateStatus (const int status)
 {
     if (infoPacket()->cameraStatus != status) {
+        m_mutex.lock();
         infoPacket()->cameraStatus = status;
+        m_mutex.unlock();
+
         emit newCameraStatus (id());
     }
 }
 
+/**
+ * Updates the bitrate budget of the camera and emits the appropiate signals
+ */
+void QCCTV_RemoteCamera::updateBitrate (const int bitrate)
+{
+    if (infoPacket()->bitrate != bitrate) {
+        m_mutex.lock();
+        infoPacket()->bitrate = bitrate;
+        m_mutex.unlock();
+
+        emit bitrateChanged (id());
+    }
+}
+
+/**
+ * Updates the JPEG quality reported by the camera
+ */
+void QCCTV_RemoteCamera::updateQuality (const int quality)
+{
+    if (infoPacket()->quality != quality) {
+        m_mutex.lock();
+        infoPacket()->quality = quality;
+        m_mutex.unlock();
+
+        emit qualityChanged (id());
+    }
+}
+
 /**
  * Updates the \a name reported by the camera
  */
 void QCCTV_RemoteCamera::updateName (const QString& name)
 {
     if (infoPacket()->cameraName != name) {
+        m_mutex.lock();
         infoPacket()->cameraName = name;
         if (infoPacket()->cameraName.isEmpty())
             infoPacket()->cameraName = "Unknown Camera";
+        m_mutex.unlock();
 
         emit newCameraName (id());
     }
@@ -487,9 +911,11 @@ void QCCTV_RemoteCamera::updateName (const QString& name)
 void QCCTV_RemoteCamera::updateGroup (const QString& group)
 {
     if (infoPacket()->cameraGroup != group) {
+        m_mutex.lock();
         infoPacket()->cameraGroup = group;
         if (infoPacket()->cameraGroup.isEmpty())
             infoPacket()->cameraGroup = "Default";
+        m_mutex.unlock();
 
         emit newCameraGroup();
     }
@@ -500,9 +926,13 @@ void QCCTV_RemoteCamera::updateGroup (const QString& group)
  */
 void QCCTV_RemoteCamera::updateConnected (const bool status)
 {
+    m_mutex.lock();
     m_connected = status;
+    m_mutex.unlock();
 
     if (m_connected) {
+        m_reconnectAttempts = 0;
+        publishAnnouncement();
         emit connected (id());
         emit fpsChanged (id());
         emit resolutionChanged (id());
@@ -516,7 +946,10 @@ void QCCTV_RemoteCamera::updateConnected (const bool status)
 void QCCTV_RemoteCamera::updateZoomSupport (const bool support)
 {
     if (infoPacket()->supportsZoom != support) {
+        m_mutex.lock();
         infoPacket()->supportsZoom = support;
+        m_mutex.unlock();
+
         emit zoomSupportChanged (id());
     }
 }
@@ -527,9 +960,11 @@ void QCCTV_RemoteCamera::updateZoomSupport (const bool support)
 void QCCTV_RemoteCamera::updateResolution (const int resolution)
 {
     if (infoPacket()->resolution != resolution) {
+        m_mutex.lock();
         infoPacket()->resolution = resolution;
-        commandPacket()->oldResolution = resolution;
-        commandPacket()->newResolution = resolution;
+        m_mutex.unlock();
+
+        publishAnnouncement();
         emit resolutionChanged (id());
     }
 }
@@ -540,9 +975,10 @@ void QCCTV_RemoteCamera::updateResolution (const int resolution)
 void QCCTV_RemoteCamera::updateAutoRegulate (const bool regulate)
 {
     if (infoPacket()->autoRegulateResolution != regulate) {
+        m_mutex.lock();
         infoPacket()->autoRegulateResolution = regulate;
-        commandPacket()->oldAutoRegulateResolution = regulate;
-        commandPacket()->newAutoRegulateResolution = regulate;
+        m_mutex.unlock();
+
         emit autoRegulateResolutionChanged (id());
     }
 }
@@ -553,27 +989,125 @@ void QCCTV_RemoteCamera::updateAutoRegulate (const bool regulate)
 void QCCTV_RemoteCamera::updateFlashlightEnabled (const bool enabled)
 {
     if (infoPacket()->flashlightEnabled != enabled) {
+        m_mutex.lock();
         infoPacket()->flashlightEnabled = enabled;
-        commandPacket()->oldFlashlightEnabled = enabled;
-        commandPacket()->newFlashlightEnabled = enabled;
+        m_mutex.unlock();
+
         emit lightStatusChanged (id());
     }
 }
 
 /**
- * Called when we receive a datagram from the camera, this function
- * obtains the latest image from the camera
+ * Called when we receive stream data from the camera, this function extracts
+ * every complete frame from the buffer and obtains the latest image from
+ * the camera.
+ *
+ * The payload checksum is updated with the bytes that arrived since the last
+ * call, but frames are only decoded once their declared length has been
+ * received. If a frame header is invalid, the buffer is re-synchronized with
+ * the next frame header found in the stream.
  */
 void QCCTV_RemoteCamera::readImagePacket()
 {
+    QCCTV_FrameHeader header;
+
+    while (m_buffer.size() >= QCCTV_FRAME_HEADER_SIZE) {
+        /* Header is invalid, skip to the next frame header */
+        if (!QCCTV_ReadFrameHeader (&header, m_buffer.data(), m_buffer.size())) {
+            int index = QCCTV_FindFrameHeader (m_buffer.view (m_buffer.size()), 1);
+            if (index > 0)
+                m_buffer.consume (index);
+            else
+                m_buffer.consume (m_buffer.size() - 3);
+
+            m_checkedBytes = 0;
+            continue;
+        }
+
+        /* Use the checksum algorithm of the frame */
+        if (m_checkedBytes == 0)
+            m_checksum.init (header.algorithm);
+
+        /* Fold the payload bytes that arrived since the last call */
+        const int received = qMin ((int) header.length,
+                                   m_buffer.size() - QCCTV_FRAME_HEADER_SIZE);
+        m_checksum.update (m_buffer.data() + QCCTV_FRAME_HEADER_SIZE
+                           + m_checkedBytes, received - m_checkedBytes);
+        m_checkedBytes = received;
+
+        /* Wait until we receive the whole frame */
+        const int length = QCCTV_FRAME_HEADER_SIZE + header.length;
+        if (m_buffer.size() < length)
+            return;
+
+        /* Read the frame in place and consume it */
+        readFrame (m_buffer.view (length),
+                   m_checksum.final() == header.checksum);
+        m_buffer.consume (length);
+        m_checkedBytes = 0;
+    }
+}
+
+/**
+ * Validates and decodes the given (complete) \a frame and updates the
+ * current image of the camera.
+ *
+ * Delta frames are drawn over the current image, if we lost the frame that
+ * preceded a delta frame, we ask the camera to send a new keyframe right away.
+ *
+ * If \a verified is \c true, the payload checksum was already validated
+ * while the frame was being received and it is not computed again
+ */
+void QCCTV_RemoteCamera::readFrame (const QByteArray& frame, const bool verified)
+{
+    QCCTV_FrameHeader header;
+    if (!QCCTV_ReadFrameHeader (&header, frame))
+        return;
+
+    /* Read the info packets multiplexed in the stream */
+    if (header.channel == QCCTV_CHANNEL_INFO) {
+        QByteArray payload;
+        if (QCCTV_ReadChannelPacket (&payload, frame))
+            readInfoPacket (payload);
+
+        return;
+    }
+
+    /* Ignore other channels */
+    if (header.channel != QCCTV_CHANNEL_VIDEO)
+        return;
+
+    /* Check that the delta frame can be applied to the current image */
+    if (header.flags & QCCTV_FRAME_DELTA) {
+        if (m_hasReference && header.sequence == m_sequence)
+            return;
+
+        if (!m_hasReference || header.sequence != m_sequence + 1) {
+            requestKeyframe (header.sequence);
+            return;
+        }
+    }
+
+    /* Read the frame */
     QCCTV_ImagePacket packet;
-    if (QCCTV_ReadImagePacket (&packet, m_data)) {
-        /* Clear buffer and send another command packet */
-        clearBuffer();
+    packet.image = imagePacket()->image;
+    if (!QCCTV_ReadImagePacket (&packet, frame, verified))
+        requestKeyframe (header.sequence);
+
+    /* Update the reference used for delta frames */
+    else {
+        m_hasReference = true;
+        m_sequence = packet.sequence;
+        if (packet.flags & QCCTV_FRAME_KEYFRAME)
+            commandPacket()->keyframeRequest = false;
+
+        /* Send another command packet */
         acknowledgeReception();
 
         /* Re-assign image */
+        m_mutex.lock();
         imagePacket()->image = packet.image;
+        m_mutex.unlock();
         emit newImage (id());
 
         /* Reset the watchdog */
@@ -591,6 +1125,161 @@ void QCCTV_RemoteCamera::readImagePacket()
     }
 }
 
+/**
+ * Adds the given UDP \a data to the frame that it belongs to. Once all the
+ * fragments of a frame are received, the frame is read and the incomplete
+ * frames that are older than it are discarded.
+ *
+ * Incomplete frames are also discarded if they are not completed before
+ * their deadline. The delta frames that follow a discarded frame cannot be
+ * decoded, so a lost datagram costs us the frames that arrive before the
+ * keyframe that we request when we notice the gap
+ */
+void QCCTV_RemoteCamera::readDatagram (const QByteArray& data)
+{
+    QCCTV_Datagram datagram;
+    if (m_transport == QCCTV_TRANSPORT_TCP ||
+        !QCCTV_ReadDatagram (&datagram, data))
+        return;
+
+    /* Drop incomplete frames that missed their deadline */
+    const qint64 now = QCCTV_Timestamp() / 1000;
+    QMutableMapIterator<quint32, QCCTV_PartialFrame> it (m_partialFrames);
+    while (it.hasNext()) {
+        it.next();
+        if (it.value().deadline < now)
+            it.remove();
+    }
+
+    /* Register a new frame */
+    if (!m_partialFrames.contains (datagram.frame)) {
+        if (m_partialFrames.count() >= QCCTV_MAX_PARTIAL_FRAMES)
+            m_partialFrames.erase (m_partialFrames.begin());
+
+        QCCTV_PartialFrame frame;
+        frame.received = 0;
+        frame.deadline = now + QCCTV_REASSEMBLY_TIMEOUT;
+        frame.fragments.resize (datagram.count);
+        m_partialFrames.insert (datagram.frame, frame);
+    }
+
+    /* Ignore duplicated and inconsistent fragments */
+    QCCTV_PartialFrame& frame = m_partialFrames [datagram.frame];
+    if (frame.fragments.count() != datagram.count ||
+        !frame.fragments.at (datagram.index).isNull())
+        return;
+
+    /* Register the fragment */
+    frame.fragments [datagram.index] = datagram.payload;
+    frame.received += 1;
+
+    /* Frame is complete, discard older frames and read it */
+    if (frame.received == frame.fragments.count()) {
+        QByteArray complete;
+        foreach (QByteArray fragment, frame.fragments)
+            complete.append (fragment);
+
+        QMutableMapIterator<quint32, QCCTV_PartialFrame> old (m_partialFrames);
+        while (old.hasNext()) {
+            old.next();
+            if ((qint32) (old.key() - datagram.frame) <= 0)
+                old.remove();
+        }
+
+        readFrame (complete);
+    }
+}
+
+/**
+ * Reports the UDP port in which we want to receive the frames to the camera,
+ * or \c 0 if we want to receive the frames through the TCP connection.
+ *
+ * Stations that joined the multicast group of the camera report it through
+ * the capabilities field of the command packet
+ */
+void QCCTV_RemoteCamera::updateVideoPort()
+{
+    commandPacket()->videoPort = 0;
+    commandPacket()->capabilities &= ~QCCTV_CAPABILITY_MULTICAST;
+
+    if (m_transport == QCCTV_TRANSPORT_UDP && m_videoSocket)
+        commandPacket()->videoPort = m_videoSocket->localPort();
+
+    else if (m_transport == QCCTV_TRANSPORT_MULTICAST)
+        commandPacket()->capabilities |= QCCTV_CAPABILITY_MULTICAST;
+}
+
+/**
+ * Joins the multicast \a group advertised by the camera and switches to the
+ * multicast transport. If the camera stops advertising the group, we switch
+ * back to TCP.
+ *
+ * Lost datagrams are not re-sent, frames with missing datagrams are dropped
+ * and the resulting gap in the sequence numbers makes us request a keyframe
+ */
+void QCCTV_RemoteCamera::joinMulticastGroup (const QString& group,
+                                             const quint16 port)
+{
+    if (!m_multicastSocket)
+        return;
+
+    /* Camera disabled the multicast stream */
+    QHostAddress address (group);
+    if (address.isNull() || port == 0) {
+        if (m_transport == QCCTV_TRANSPORT_MULTICAST)
+            changeTransport (QCCTV_TRANSPORT_TCP);
+
+        m_multicastGroup.clear();
+        return;
+    }
+
+    /* Already joined (or left by the user) or unable to join the group */
+    if (m_multicastFailed || address == m_multicastGroup)
+        return;
+
+    /* Leave the old group */
+    if (m_transport == QCCTV_TRANSPORT_MULTICAST)
+        changeTransport (QCCTV_TRANSPORT_TCP);
+
+    /* Several stations in the same host may join the same group */
+    if (m_multicastSocket->bind (QHostAddress::AnyIPv4, port,
+                                 QUdpSocket::ShareAddress |
+                                 QUdpSocket::ReuseAddressHint) &&
+        m_multicastSocket->joinMulticastGroup (address)) {
+        changeTransport (QCCTV_TRANSPORT_MULTICAST);
+    }
+
+    else {
+        m_multicastSocket->close();
+        m_multicastFailed = true;
+    }
+
+    m_multicastGroup = address;
+}
+
+/**
+ * Registers the command \a fields that have been changed and schedules a
+ * command packet. Commands issued within \c QCCTV_COMMAND_COALESCE
+ * milliseconds are sent together.
+ *
+ * A \a fields value of \c 0 sends the state of the station (transport,
+ * JPEG quality, etc.) without issuing any command.
+ *
+ * The \a fields are kept apart from the fields of the command packet until
+ * they are flushed, so that acknowledging the commands already sent to the
+ * camera does not discard them
+ */
+void QCCTV_RemoteCamera::issueCommand (const int fields)
+{
+    m_pendingFields |= fields;
+
+    if (!m_commandScheduled) {
+        m_commandScheduled = true;
+        QTimer::singleShot (QCCTV_COMMAND_COALESCE, Qt::PreciseTimer,
+                            this, SLOT (flushCommands()));
+    }
+}
+
 /**
  * Resets the watchdog and sends a command packet to the camera, which allows
  * it to know if we are doing OK.
@@ -606,6 +1295,60 @@ void QCCTV_RemoteCamera::acknowledgeReception()
         updateConnected (true);
 }
 
+/**
+ * Sends the current announcement of the camera to the station, which stores
+ * it in the registry. The announcement is built here, in the thread of the
+ * camera, so that the station does not read the camera information while we
+ * change it.
+ *
+ * Cameras found through the beacon of an older version of QCCTV are not
+ * stored, since they will beacon us again within a second
+ */
+void QCCTV_RemoteCamera::publishAnnouncement()
+{
+    if (m_discoveryId >= 0)
+        emit announcementChanged (announcement());
+}
+
+/**
+ * Discards the reference image and asks the camera for a keyframe, because
+ * we could not read the frame with the given \a sequence (or a frame before
+ * it). The request is sent right away instead of waiting for the next frame
+ * or info packet, since we do not acknowledge the frames that we cannot read.
+ *
+ * If the keyframe does not arrive, the request is sent again after we
+ * receive \c QCCTV_RECOVERY_INTERVAL more frames that we cannot read
+ */
+void QCCTV_RemoteCamera::requestKeyframe (const quint32 sequence)
+{
+    m_hasReference = false;
+
+    const qint32 frames = (qint32) (sequence - m_keyframeSequence);
+    if (commandPacket()->keyframeRequest &&
+        qAbs (frames) < QCCTV_RECOVERY_INTERVAL)
+        return;
+
+    m_keyframeSequence = sequence;
+    commandPacket()->keyframeRequest = true;
+    sendCommandPacket();
+}
+
+/**
+ * Updates the discovery ID, the ports and the stream resolutions of the
+ * camera with the values of the given announcement \a packet
+ */
+void QCCTV_RemoteCamera::updateEndpoint (const QCCTV_AnnouncePacket& packet)
+{
+    QMutexLocker lock (&m_mutex);
+    m_discoveryId = packet.id;
+    m_streamResolutions = packet.rungs;
+
+    if (packet.streamPort > 0)
+        m_streamPort = packet.streamPort;
+    if (packet.commandPort > 0)
+        m_commandPort = packet.commandPort;
+}
+
 /**
  * Returns the pointer to the stream packet structure
  */
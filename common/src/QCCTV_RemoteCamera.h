@@ -23,15 +23,28 @@
 #ifndef _QCCTV_REMOTE_CAMERA_H
 #define _QCCTV_REMOTE_CAMERA_H
 
+#include <QMap>
+#include <QMutex>
+#include <QVector>
 #include <QTcpSocket>
 #include <QUdpSocket>
 
+#include "QCCTV_Checksum.h"
+#include "QCCTV_ReceiveBuffer.h"
+
 class QCCTV_Watchdog;
 class QCCTV_ImageSaver;
 struct QCCTV_InfoPacket;
 struct QCCTV_ImagePacket;
+struct QCCTV_AnnouncePacket;
 struct QCCTV_CommandPacket;
 
+struct QCCTV_PartialFrame {
+    int received;
+    qint64 deadline;
+    QVector<QByteArray> fragments;
+};
+
 class QCCTV_RemoteCamera : public QObject
 {
     Q_OBJECT
@@ -41,14 +54,19 @@ Q_SIGNALS:
     void newImage (const int id);
     void connected (const int id);
     void fpsChanged (const int id);
+    void bitrateChanged (const int id);
+    void qualityChanged (const int id);
     void disconnected (const int id);
+    void unreachable (const int id);
     void newCameraName (const int id);
     void newCameraStatus (const int id);
     void zoomLevelChanged (const int id);
+    void transportChanged (const int id);
     void resolutionChanged (const int id);
     void lightStatusChanged (const int id);
     void zoomSupportChanged (const int id);
     void autoRegulateResolutionChanged (const int id);
+    void announcementChanged (const QByteArray& announcement);
 
 public:
     QCCTV_RemoteCamera (QObject* parent = NULL);
@@ -57,9 +75,12 @@ public:
     int fps();
     int zoom();
     int status();
+    int bitrate();
+    int quality();
     QImage image();
     QString name();
     QString group();
+    int transport();
     int resolution();
     bool supportsZoom();
     QString statusString();
@@ -68,20 +89,31 @@ public:
 
     int id() const;
     bool isConnected() const;
+    qint64 discoveryId() const;
     QHostAddress address() const;
+    bool multiplexed() const;
     bool saveIncomingMedia() const;
     QString incomingMediaPath() const;
+    QList<int> streamResolutions() const;
+
+    void readAnnouncement (const QCCTV_AnnouncePacket& packet);
 
 public Q_SLOTS:
     void start();
+    void reconnect();
     void requestFocus();
     void changeID (const int id);
     void changeFPS (const int fps);
     void changeZoom (const int zoom);
+    void changeBitrate (const int bitrate);
+    void changeQuality (const int quality);
+    void changeTransport (const int transport);
+    void setMultiplexed (const bool multiplexed);
     void setSaveIncomingMedia (const bool save);
     void readInfoPacket (const QByteArray& data);
     void changeResolution (const int resolution);
     void setAddress (const QHostAddress& address);
+    void updateAnnouncement (const QByteArray& announcement);
     void changeAutoRegulate (const bool regulate);
     void changeFlashlightStatus (const int status);
     void setIncomingMediaPath (const QString& path);
@@ -89,12 +121,18 @@ public Q_SLOTS:
 private Q_SLOTS:
     void clearBuffer();
     void endConnection();
+    void flushCommands();
     void sendCommandPacket();
-    void resetFocusRequest();
+    void retryConnection();
+    void retransmitCommands();
+    void scheduleReconnect();
     void onImageDataReceived();
+    void onVideoDatagramReceived();
     void updateFPS (const int fps);
     void updateZoom (const int zoom);
     void updateStatus (const int status);
+    void updateBitrate (const int bitrate);
+    void updateQuality (const int quality);
     void updateName (const QString& name);
     void updateGroup (const QString& group);
     void updateConnected (const bool status);
@@ -105,21 +143,54 @@ private Q_SLOTS:
 
 private:
     void readImagePacket();
+    void updateVideoPort();
+    void updateEndpoint (const QCCTV_AnnouncePacket& packet);
+    void issueCommand (const int fields);
+    void joinMulticastGroup (const QString& group, const quint16 port);
+    void readFrame (const QByteArray& frame, const bool verified = false);
+    void readDatagram (const QByteArray& data);
     void acknowledgeReception();
+    void publishAnnouncement();
+    QByteArray announcement();
+    void requestKeyframe (const quint32 sequence);
     QCCTV_InfoPacket* infoPacket();
     QCCTV_ImagePacket* imagePacket();
     QCCTV_CommandPacket* commandPacket();
 
 private:
+    mutable QMutex m_mutex;
+
     int m_id;
+    int m_transport;
     bool m_connected;
-    QByteArray m_data;
+    quint32 m_sequence;
+    quint32 m_keyframeSequence;
+    bool m_hasReference;
+    bool m_multicastFailed;
+    qint64 m_infoVersion;
+    qint64 m_discoveryId;
+    quint16 m_streamPort;
+    quint16 m_commandPort;
+    QList<int> m_streamResolutions;
+    bool m_retryScheduled;
+    bool m_reconnectScheduled;
+    int m_reconnectAttempts;
+    bool m_commandScheduled;
+    quint16 m_pendingFields;
+    int m_checkedBytes;
+    QCCTV_Checksum m_checksum;
+    QCCTV_ReceiveBuffer m_buffer;
     QHostAddress m_address;
+    QHostAddress m_multicastGroup;
     QString m_incomingMediaPath;
+    bool m_multiplexed;
     bool m_saveIncomingMedia;
 
     QTcpSocket* m_socket;
+    QUdpSocket* m_videoSocket;
     QUdpSocket* m_commandSocket;
+    QUdpSocket* m_multicastSocket;
+    QMap<quint32, QCCTV_PartialFrame> m_partialFrames;
 
     QCCTV_ImageSaver* m_saver;
     QCCTV_Watchdog* m_watchdog;
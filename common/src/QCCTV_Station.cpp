@@ -23,9 +23,11 @@
 #include "QCCTV.h"
 #include "QCCTV_Station.h"
 #include "QCCTV_Discovery.h"
+#include "QCCTV_Communications.h"
 
 #include <QDir>
 #include <QThread>
+#include <QSettings>
 #include <QFileDialog>
 #include <QDesktopServices>
 
@@ -33,23 +35,29 @@ QCCTV_Station::QCCTV_Station()
 {
     /* Attempt to connect to a camera as we find it */
     QCCTV_Discovery* discovery = QCCTV_Discovery::getInstance();
-    connect (discovery, SIGNAL (newCamera       (QHostAddress)),
-             this,        SLOT (connectToCamera (QHostAddress)));
+    connect (discovery, SIGNAL (newCamera       (QHostAddress, QByteArray)),
+             this,        SLOT (connectToCamera (QHostAddress, QByteArray)));
     connect (discovery, SIGNAL (newInfoPacket   (QHostAddress, QByteArray)),
              this,        SLOT (readInfoPacket  (QHostAddress, QByteArray)));
 
-    /* Remove a camera when we disconnect from it */
+    /* Ask the cameras to announce themselves when we lose one of them */
+    connect (this,      SIGNAL (disconnected (int)),
+             discovery,   SLOT (probe()));
+
+    /* Update the camera list when we connect to a camera */
     connect (this, SIGNAL (connected (int)),
              this, SIGNAL (cameraCountChanged()));
-    connect (this, SIGNAL (disconnected (int)),
-             this,   SLOT (removeCamera (int)));
     connect (this, SIGNAL (cameraCountChanged()),
              this,   SLOT (updateGroups()));
 
     /* Set camera error image */
     setRecordingsPath ("");
+    setMultiplexed (false);
     setSaveIncomingMedia (true);
     m_cameraError = QCCTV_CreateStatusImage (QSize (640, 480), "CAMERA ERROR");
+
+    /* Reconnect to the cameras found during the last session */
+    loadRegistry();
 }
 
 /**
@@ -120,6 +128,15 @@ QString QCCTV_Station::recordingsPath() const
     return m_recordingsPath;
 }
 
+/**
+ * Returns \c true if the command and info packets are exchanged through the
+ * stream connection of each camera instead of separate UDP sockets
+ */
+bool QCCTV_Station::multiplexed() const
+{
+    return m_multiplexed;
+}
+
 /**
  * Returns \c true if the station should save received camera frames
  * to the hard disk
@@ -202,6 +219,40 @@ int QCCTV_Station::zoom (const int camera)
     return 0;
 }
 
+/**
+ * Returns the maximum bitrate (in kbps) assigned to the given \a camera,
+ * a value of \c 0 means that the bitrate of the camera is not limited
+ */
+int QCCTV_Station::bitrate (const int camera)
+{
+    if (getCamera (camera))
+        return getCamera (camera)->bitrate();
+
+    return 0;
+}
+
+/**
+ * Returns the JPEG quality used by the given \a camera
+ */
+int QCCTV_Station::quality (const int camera)
+{
+    if (getCamera (camera))
+        return getCamera (camera)->quality();
+
+    return 0;
+}
+
+/**
+ * Returns the transport used to receive the frames of the given \a camera
+ */
+int QCCTV_Station::transport (const int camera)
+{
+    if (getCamera (camera))
+        return getCamera (camera)->transport();
+
+    return (int) QCCTV_TRANSPORT_TCP;
+}
+
 /**
  * Returns the current resolution used by the camera
  */
@@ -439,7 +490,26 @@ void QCCTV_Station::chooseRecordingsPath()
 void QCCTV_Station::focusCamera (const int camera)
 {
     if (getCamera (camera))
-        getCamera (camera)->requestFocus();
+        QMetaObject::invokeMethod (getCamera (camera), "requestFocus",
+                                   Qt::QueuedConnection);
+}
+
+/**
+ * Enables or disables the multiplexed mode, in which the command and info
+ * packets are exchanged through the stream connection of each camera. This
+ * avoids routing the info packets through the main thread and reduces the
+ * number of sockets, but cameras that do not support it ignore our commands
+ */
+void QCCTV_Station::setMultiplexed (const bool multiplexed)
+{
+    m_multiplexed = multiplexed;
+
+    foreach (QCCTV_RemoteCamera* camera, m_cameras)
+        QMetaObject::invokeMethod (camera, "setMultiplexed",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (bool, multiplexed));
+
+    emit multiplexedChanged();
 }
 
 /**
@@ -450,7 +520,9 @@ void QCCTV_Station::setSaveIncomingMedia (const bool save)
     m_saveIncomingMedia = save;
 
     foreach (QCCTV_RemoteCamera* camera, m_cameras)
-        camera->setSaveIncomingMedia (saveIncomingMedia());
+        QMetaObject::invokeMethod (camera, "setSaveIncomingMedia",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (bool, saveIncomingMedia()));
 
     emit saveIncomingMediaChanged();
 }
@@ -479,18 +551,26 @@ void QCCTV_Station::setRecordingsPath (const QString& path)
 
     foreach (QCCTV_RemoteCamera* camera, m_cameras)
         if (camera)
-            camera->setIncomingMediaPath (recordingsPath());
+            QMetaObject::invokeMethod (camera, "setIncomingMediaPath",
+                                       Qt::QueuedConnection,
+                                       Q_ARG (QString, recordingsPath()));
 
     emit recordingsPathChanged();
 }
 
 /**
- * Changes the zoom status of the given \a camera
+ * Changes the zoom status of the given \a camera.
+ *
+ * Each camera controller runs in its own thread, so this function (and every
+ * function that changes the settings of a camera) queues the call in the
+ * thread of the camera instead of changing its state from this thread
  */
 void QCCTV_Station::setZoom (const int camera, const int zoom)
 {
     if (getCamera (camera))
-        getCamera (camera)->changeZoom (zoom);
+        QMetaObject::invokeMethod (getCamera (camera), "changeZoom",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, zoom));
 }
 
 /**
@@ -501,7 +581,50 @@ void QCCTV_Station::setZoom (const int camera, const int zoom)
 void QCCTV_Station::changeFPS (const int camera, const int fps)
 {
     if (getCamera (camera))
-        getCamera (camera)->changeFPS (fps);
+        QMetaObject::invokeMethod (getCamera (camera), "changeFPS",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, fps));
+}
+
+/**
+ * Changes the maximum \a bitrate (in kbps) of the given \a camera
+ * \note If the \a camera parameter is invalid, then this function
+ *       shall have no effect
+ */
+void QCCTV_Station::changeBitrate (const int camera, const int bitrate)
+{
+    if (getCamera (camera))
+        QMetaObject::invokeMethod (getCamera (camera), "changeBitrate",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, bitrate));
+}
+
+/**
+ * Changes the JPEG \a quality of the images that the given \a camera sends
+ * to this station, a \a quality of 0 lets the camera regulate it
+ * \note If the \a camera parameter is invalid, then this function
+ *       shall have no effect
+ */
+void QCCTV_Station::changeQuality (const int camera, const int quality)
+{
+    if (getCamera (camera))
+        QMetaObject::invokeMethod (getCamera (camera), "changeQuality",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, quality));
+}
+
+/**
+ * Selects the \a transport (TCP or UDP) used to receive the frames of the
+ * given \a camera
+ * \note If the \a camera parameter is invalid, then this function
+ *       shall have no effect
+ */
+void QCCTV_Station::changeTransport (const int camera, const int transport)
+{
+    if (getCamera (camera))
+        QMetaObject::invokeMethod (getCamera (camera), "changeTransport",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, transport));
 }
 
 /**
@@ -521,7 +644,9 @@ void QCCTV_Station::setFlashlightEnabledAll (const bool enabled)
 void QCCTV_Station::changeResolution (const int camera, const int resolution)
 {
     if (getCamera (camera))
-        getCamera (camera)->changeResolution (resolution);
+        QMetaObject::invokeMethod (getCamera (camera), "changeResolution",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, resolution));
 }
 
 /**
@@ -532,7 +657,9 @@ void QCCTV_Station::changeResolution (const int camera, const int resolution)
 void QCCTV_Station::setFlashlightEnabled (const int camera, const bool enabled)
 {
     if (getCamera (camera))
-        getCamera (camera)->changeFlashlightStatus ((int) enabled);
+        QMetaObject::invokeMethod (getCamera (camera), "changeFlashlightStatus",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (int, (int) enabled));
 }
 
 /**
@@ -545,7 +672,46 @@ void QCCTV_Station::setAutoRegulateResolution (const int camera,
                                                const bool regulate)
 {
     if (getCamera (camera))
-        getCamera (camera)->changeAutoRegulate (regulate);
+        QMetaObject::invokeMethod (getCamera (camera), "changeAutoRegulate",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (bool, regulate));
+}
+
+/**
+ * Writes the address and the last announcement of each camera to the
+ * registry, so that we can connect to them directly on the next startup
+ */
+void QCCTV_Station::saveRegistry()
+{
+    QSettings settings;
+    settings.remove (QCCTV_REGISTRY_KEY);
+    settings.beginWriteArray (QCCTV_REGISTRY_KEY);
+
+    int index = 0;
+    foreach (QCCTV_RemoteCamera* camera, m_cameras) {
+        if (camera && m_announcements.contains (camera)) {
+            settings.setArrayIndex (index++);
+            settings.setValue ("address", camera->address().toString());
+            settings.setValue ("announcement", m_announcements.value (camera));
+        }
+    }
+
+    settings.endArray();
+}
+
+/**
+ * Stores the \a announcement of the camera that sent it, which is built by
+ * the camera in its own thread when we connect to it or when its resolution
+ * or ports change, and updates the registry
+ */
+void QCCTV_Station::storeAnnouncement (const QByteArray& announcement)
+{
+    QCCTV_RemoteCamera* camera = qobject_cast<QCCTV_RemoteCamera*> (sender());
+    if (!camera || !m_cameras.contains (camera))
+        return;
+
+    m_announcements.insert (camera, announcement);
+    saveRegistry();
 }
 
 /**
@@ -557,6 +723,7 @@ void QCCTV_Station::removeCamera (const int camera)
 {
     if (getCamera (camera)) {
         /* Stop the camera */
+        m_announcements.remove (m_cameras.at (camera));
         m_cameras.at (camera)->deleteLater();
         m_cameras.removeAt (camera);
 
@@ -577,17 +744,55 @@ void QCCTV_Station::removeCamera (const int camera)
     }
 }
 
+/**
+ * Removes the given \a camera after it failed to answer our reconnection
+ * attempts, and removes it from the registry too
+ */
+void QCCTV_Station::forgetCamera (const int camera)
+{
+    removeCamera (camera);
+    saveRegistry();
+}
+
 /**
  * Tries to establish a connection with a QCCTV camera running
  * in a host with the given \a ip address
  *
- * If the remote camera does not respond after some seconds,
- * then the new camera controller shall be automatically
- * deleted from the camera list
- */
-void QCCTV_Station::connectToCamera (const QHostAddress& ip)
-{
-    if (!ip.isNull() && !cameraIPs().contains (ip)) {
+ * If the connection with the camera is lost, the camera controller keeps
+ * its ID and tries to reconnect to the camera. If the remote camera does not
+ * respond after some seconds, then the camera controller shall be
+ * automatically deleted from the camera list
+ */
+void QCCTV_Station::connectToCamera (const QHostAddress& ip,
+                                     const QByteArray& announcement)
+{
+    /* Older cameras do not announce themselves, they only send a beacon */
+    QCCTV_AnnouncePacket packet;
+    const bool announced = QCCTV_ReadAnnouncePacket (&packet, announcement);
+
+    /* We already reach the camera through another network interface */
+    if (announced) {
+        foreach (QCCTV_RemoteCamera* camera, m_cameras)
+            if (camera && camera->isConnected() &&
+                camera->discoveryId() == packet.id)
+                return;
+    }
+
+    /* The camera is back, do not wait for the next reconnection attempt */
+    QCCTV_RemoteCamera* existing = getCamera (cameraIndex (ip));
+    if (existing) {
+        if (announced)
+            QMetaObject::invokeMethod (existing, "updateAnnouncement",
+                                       Qt::QueuedConnection,
+                                       Q_ARG (QByteArray, announcement));
+
+        if (!existing->isConnected())
+            QMetaObject::invokeMethod (existing, "reconnect",
+                                       Qt::QueuedConnection);
+        return;
+    }
+
+    if (!ip.isNull()) {
         QThread* thread = new QThread;
         QCCTV_RemoteCamera* camera = new QCCTV_RemoteCamera;
 
@@ -599,7 +804,12 @@ void QCCTV_Station::connectToCamera (const QHostAddress& ip)
         camera->setAddress (ip);
         camera->changeID (cameraCount() - 1);
         camera->setIncomingMediaPath (recordingsPath());
+        camera->setMultiplexed (multiplexed());
         camera->setSaveIncomingMedia (saveIncomingMedia());
+        if (announced) {
+            camera->readAnnouncement (packet);
+            m_announcements.insert (camera, announcement);
+        }
 
         /* Start timers when thread is started */
         connect (thread, SIGNAL (started()),
@@ -614,8 +824,14 @@ void QCCTV_Station::connectToCamera (const QHostAddress& ip)
                  this,   SIGNAL (connected (int)));
         connect (camera, SIGNAL (disconnected (int)),
                  this,   SIGNAL (disconnected (int)));
+        connect (camera, SIGNAL (unreachable (int)),
+                 this,     SLOT (forgetCamera (int)));
         connect (camera, SIGNAL (fpsChanged (int)),
                  this,   SIGNAL (fpsChanged (int)));
+        connect (camera, SIGNAL (bitrateChanged (int)),
+                 this,   SIGNAL (bitrateChanged (int)));
+        connect (camera, SIGNAL (qualityChanged (int)),
+                 this,   SIGNAL (qualityChanged (int)));
         connect (camera, SIGNAL (newCameraName (int)),
                  this,   SIGNAL (cameraNameChanged (int)));
         connect (camera, SIGNAL (newCameraStatus (int)),
@@ -628,12 +844,16 @@ void QCCTV_Station::connectToCamera (const QHostAddress& ip)
                  this,   SIGNAL (zoomSupportChanged (int)));
         connect (camera, SIGNAL (resolutionChanged (int)),
                  this,   SIGNAL (resolutionChanged (int)));
+        connect (camera, SIGNAL (transportChanged (int)),
+                 this,   SIGNAL (transportChanged (int)));
         connect (camera, SIGNAL (lightStatusChanged (int)),
                  this,   SIGNAL (lightStatusChanged (int)));
         connect (camera, SIGNAL (autoRegulateResolutionChanged (int)),
                  this,   SIGNAL (autoRegulateResolutionChanged (int)));
         connect (camera, SIGNAL (newCameraGroup()),
                  this,     SLOT (updateGroups()));
+        connect (camera, SIGNAL (announcementChanged (QByteArray)),
+                 this,     SLOT (storeAnnouncement (QByteArray)));
     }
 }
 
@@ -644,9 +864,41 @@ void QCCTV_Station::connectToCamera (const QHostAddress& ip)
 void QCCTV_Station::readInfoPacket (const QHostAddress& address,
                                     const QByteArray& data)
 {
-    if (cameraIPs().contains (address)) {
-        int camera = cameraIPs().indexOf (address);
-        if (getCamera (camera))
-            getCamera (camera)->readInfoPacket (data);
+    const int camera = cameraIndex (address);
+    if (getCamera (camera))
+        QMetaObject::invokeMethod (getCamera (camera), "readInfoPacket",
+                                   Qt::QueuedConnection,
+                                   Q_ARG (QByteArray, data));
+}
+
+/**
+ * Connects to the cameras stored in the registry, each camera controller
+ * runs in its own thread, so all the connections are opened in parallel
+ */
+void QCCTV_Station::loadRegistry()
+{
+    QSettings settings;
+    const int count = settings.beginReadArray (QCCTV_REGISTRY_KEY);
+
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex (i);
+        connectToCamera (QHostAddress (settings.value ("address").toString()),
+                         settings.value ("announcement").toByteArray());
     }
+
+    settings.endArray();
+}
+
+/**
+ * Returns the index of the camera with the given \a address, or \c -1 if
+ * we are not connected to it
+ */
+int QCCTV_Station::cameraIndex (const QHostAddress& address) const
+{
+    for (int i = 0; i < m_cameras.count(); ++i) {
+        if (m_cameras.at (i) && m_cameras.at (i)->address() == address)
+            return i;
+    }
+
+    return -1;
 }
@@ -37,13 +37,17 @@ Q_SIGNALS:
     void groupCountChanged();
     void cameraCountChanged();
     void recordingsPathChanged();
+    void multiplexedChanged();
     void saveIncomingMediaChanged();
     void connected (const int camera);
     void fpsChanged (const int camera);
+    void bitrateChanged (const int camera);
+    void qualityChanged (const int camera);
     void disconnected (const int camera);
     void newCameraImage (const int camera);
     void zoomLevelChanged (const int camera);
     void cameraNameChanged (const int camera);
+    void transportChanged (const int camera);
     void resolutionChanged (const int camera);
     void lightStatusChanged (const int camera);
     void zoomSupportChanged (const int camera);
@@ -63,6 +67,7 @@ public:
 
     Q_INVOKABLE QStringList groups() const;
     Q_INVOKABLE QString recordingsPath() const;
+    Q_INVOKABLE bool multiplexed() const;
     Q_INVOKABLE bool saveIncomingMedia() const;
     Q_INVOKABLE QStringList availableResolutions() const;
 
@@ -71,6 +76,9 @@ public:
 
     Q_INVOKABLE int fps (const int camera);
     Q_INVOKABLE int zoom (const int camera);
+    Q_INVOKABLE int bitrate (const int camera);
+    Q_INVOKABLE int quality (const int camera);
+    Q_INVOKABLE int transport (const int camera);
     Q_INVOKABLE int resolution (const int camera);
     Q_INVOKABLE int cameraStatus (const int camera);
     Q_INVOKABLE bool supportsZoom (const int camera);
@@ -93,27 +101,41 @@ public Q_SLOTS:
     void openRecordingsPath();
     void chooseRecordingsPath();
     void focusCamera (const int camera);
+    void setMultiplexed (const bool multiplexed);
     void setSaveIncomingMedia (const bool save);
     void setRecordingsPath (const QString& path);
     void setZoom (const int camera, const int zoom);
     void changeFPS (const int camera, const int fps);
+    void changeBitrate (const int camera, const int bitrate);
+    void changeQuality (const int camera, const int quality);
+    void changeTransport (const int camera, const int transport);
     void setFlashlightEnabledAll (const bool enabled);
     void changeResolution (const int camera, const int resolution);
     void setFlashlightEnabled (const int camera, const bool enabled);
     void setAutoRegulateResolution (const int camera, const bool regulate);
 
 private Q_SLOTS:
+    void saveRegistry();
+    void storeAnnouncement (const QByteArray& announcement);
     void removeCamera (const int camera);
-    void connectToCamera (const QHostAddress& ip);
+    void forgetCamera (const int camera);
+    void connectToCamera (const QHostAddress& ip,
+                          const QByteArray& announcement);
     void readInfoPacket (const QHostAddress& address, const QByteArray& data);
 
+private:
+    void loadRegistry();
+    int cameraIndex (const QHostAddress& address) const;
+
 private:
     QImage m_cameraError;
     QStringList m_groups;
     QString m_recordingsPath;
+    bool m_multiplexed;
     bool m_saveIncomingMedia;
     QList<QThread*> m_threads;
     QList<QCCTV_RemoteCamera*> m_cameras;
+    QMap<QCCTV_RemoteCamera*, QByteArray> m_announcements;
 };
 
 #endif
@@ -0,0 +1,52 @@
+#
+# Copyright (c) 2016 Alex Spataru
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# Standalone conformance test and benchmark of the CRC32 and CRC32C kernels,
+# this target is not part of QCCTV.pro, build it with
+# "qmake tests/tests.pro && make".
+#
+# The PMULL and ARMv8 CRC32C kernels are only compiled when the compiler
+# targets the ARMv8 crypto and CRC extensions, so we enable them on 64-bit
+# ARM to test them
+#
+
+TEMPLATE = app
+TARGET = checksum-bench
+
+QT = core
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = obj
+INCLUDEPATH += $$PWD/../../common/src
+
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE *= -O3
+
+contains (QT_ARCH, arm64) {
+    QMAKE_CXXFLAGS += -march=armv8-a+crypto+crc
+}
+
+HEADERS += $$PWD/../../common/src/QCCTV_CRC32.h \
+           $$PWD/../../common/src/QCCTV_Checksum.h
+SOURCES += $$PWD/main.cpp
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+/*
+ * Conformance test and benchmark of the CRC32 and CRC32C kernels.
+ *
+ * The implementation files are compiled into this program, so that every
+ * kernel can be called directly. Each kernel is compared with a plain
+ * byte-at-a-time table CRC over random lengths and alignments, and the
+ * throughput of each kernel is printed at the end.
+ *
+ * This program returns a non-zero exit code if any checksum is wrong.
+ */
+
+#include <QElapsedTimer>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "QCCTV_CRC32.cpp"
+#include "QCCTV_Checksum.cpp"
+
+#define ITERATIONS  20000
+#define MAX_LENGTH  4096
+#define MAX_OFFSET  16
+#define BENCH_SIZE  (256 * 1024)
+#define BENCH_BYTES (1024 * 1024 * 1024)
+
+#if defined (QCCTV_CRC32_PCLMUL)
+    #define FOLD_KERNEL_NAME "pclmul"
+#elif defined (QCCTV_CRC32_PMULL)
+    #define FOLD_KERNEL_NAME "pmull"
+#else
+    #define FOLD_KERNEL_NAME "none"
+#endif
+
+#if defined (QCCTV_CRC32C_SSE42)
+    #define CRC32C_KERNEL_NAME "sse4.2"
+#elif defined (QCCTV_CRC32C_ARMV8)
+    #define CRC32C_KERNEL_NAME "armv8"
+#else
+    #define CRC32C_KERNEL_NAME "none"
+#endif
+
+/*
+ * CRC32C kernel that uses the CRC32 instructions of the CPU (if any)
+ */
+static const CRC32CFunction CRC32C_KERNEL =
+    CRC32C != &crc32c_slice_by_8 ? CRC32C : NULL;
+
+static int FAILURES = 0;
+
+/**
+ * QCCTV.cpp needs QtGui, so we list the algorithms of a build without xxHash
+ * here instead of linking it
+ */
+int QCCTV_SupportedChecksums()
+{
+    return (1 << QCCTV_CHECKSUM_CRC32) | (1 << QCCTV_CHECKSUM_CRC32C);
+}
+
+/**
+ * Returns a pseudo-random number (xorshift32), the sequence is the same in
+ * every run, so that failures can be reproduced
+ */
+static quint32 random32()
+{
+    static quint32 state = 0x2545F491;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/**
+ * Reference implementation, which processes one byte at a time with the
+ * classic lookup table
+ */
+static quint32 table_crc (quint32 crc, const uchar* data, int len)
+{
+    while (len-- > 0)
+        crc = TABLES.table [0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+/**
+ * Reference implementation of CRC32C, which processes one byte at a time
+ * with the classic lookup table
+ */
+static quint32 table_crc32c (quint32 crc, const uchar* data, int len)
+{
+    while (len-- > 0)
+        crc = CRC32C_TABLES.table [0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+/**
+ * Compares the \a result of the given \a kernel with the \a expected value
+ */
+static void check (const char* kernel, const quint32 result,
+                   const quint32 expected, const int len, const int offset)
+{
+    if (result != expected) {
+        ++FAILURES;
+        if (FAILURES <= 10)
+            printf ("FAIL %-10s len=%-5d offset=%-2d got %08x expected %08x\n",
+                    kernel, len, offset, result, expected);
+    }
+}
+
+/**
+ * Prints the throughput of the given \a kernel in GB/s
+ */
+static void bench (const char* name, FoldFunction kernel, const uchar* data)
+{
+    QElapsedTimer timer;
+    quint32 crc = 0xFFFFFFFFUL;
+
+    timer.start();
+    for (int i = 0; i < BENCH_BYTES / BENCH_SIZE; ++i)
+        crc = kernel (crc, data, BENCH_SIZE);
+
+    const qint64 time = qMax (timer.nsecsElapsed(), (qint64) 1);
+    printf ("%-10s %8.2f GB/s  (%08x)\n", name,
+            (double) BENCH_BYTES / time, crc);
+}
+
+/**
+ * Calls the public interface, which combines the folding kernel with the
+ * slicing-by-8 tables
+ */
+static quint32 public_crc (quint32 crc, const uchar* data, int len)
+{
+    static QCCTV_CRC32 crc32;
+    return crc ^ crc32.compute ((const char*) data, len);
+}
+
+/**
+ * Calls the public interface of CRC32C, which uses the kernel selected for
+ * this CPU
+ */
+static quint32 public_crc32c (quint32 crc, const uchar* data, int len)
+{
+    return crc ^ QCCTV_Checksum::compute (QCCTV_CHECKSUM_CRC32C,
+                                          (const char*) data, len);
+}
+
+int main()
+{
+    static uchar buffer [BENCH_SIZE + MAX_OFFSET];
+    for (int i = 0; i < (int) sizeof (buffer); ++i)
+        buffer[i] = random32() & 0xFF;
+
+    /* Standard check value of the CRC32 */
+    QCCTV_CRC32 crc32;
+    check ("check", crc32.compute ("123456789", 9), 0xCBF43926UL, 9, 0);
+
+    /* Standard check value of the CRC32C */
+    QCCTV_Checksum checksum;
+    check ("check-c", QCCTV_Checksum::compute (QCCTV_CHECKSUM_CRC32C,
+                                               "123456789", 9),
+           0xE3069283UL, 9, 0);
+
+    for (int i = 0; i < ITERATIONS; ++i) {
+        const int offset = random32() % MAX_OFFSET;
+        const int len = random32() % (MAX_LENGTH + 1);
+        const uchar* data = buffer + offset;
+        const quint32 seed = random32();
+        const quint32 expected = table_crc (seed, data, len);
+
+        /* Slicing-by-8 accepts any length */
+        check ("slice8", slice_by_8 (seed, data, len), expected, len, offset);
+
+        /* Folding kernels need a multiple of 16 bytes and at least 64 */
+        const int folded = len & ~15;
+        if (KERNEL && folded >= FOLD_MIN_BYTES)
+            check (FOLD_KERNEL_NAME, KERNEL (seed, data, folded),
+                   table_crc (seed, data, folded), folded, offset);
+
+        /* Public interface, at once and split in two updates */
+        check ("compute", crc32.compute ((const char*) data, len),
+               table_crc (0xFFFFFFFFUL, data, len) ^ 0xFFFFFFFFUL, len, offset);
+
+        const int split = len > 0 ? random32() % len : 0;
+        crc32.init();
+        crc32.update ((const char*) data, split);
+        crc32.update ((const char*) data + split, len - split);
+        check ("update", crc32.final(),
+               table_crc (0xFFFFFFFFUL, data, len) ^ 0xFFFFFFFFUL, len, offset);
+
+        /* CRC32C kernels accept any length */
+        const quint32 expected_c = table_crc32c (seed, data, len);
+        check ("slice8-c", crc32c_slice_by_8 (seed, data, len), expected_c,
+               len, offset);
+        if (CRC32C_KERNEL)
+            check (CRC32C_KERNEL_NAME, CRC32C_KERNEL (seed, data, len),
+                   expected_c, len, offset);
+
+        /* Public interface of CRC32C, at once and split in two updates */
+        const quint32 final_c = table_crc32c (0xFFFFFFFFUL, data, len) ^
+                                0xFFFFFFFFUL;
+        check ("compute-c", QCCTV_Checksum::compute (QCCTV_CHECKSUM_CRC32C,
+                                                     (const char*) data, len),
+               final_c, len, offset);
+
+        checksum.init (QCCTV_CHECKSUM_CRC32C);
+        checksum.update ((const char*) data, split);
+        checksum.update ((const char*) data + split, len - split);
+        check ("update-c", checksum.final(), final_c, len, offset);
+    }
+
+    printf ("%d checks failed, folding kernel: %s%s, CRC32C kernel: %s%s\n\n",
+            FAILURES, FOLD_KERNEL_NAME,
+            KERNEL ? "" : " (not supported by this CPU)", CRC32C_KERNEL_NAME,
+            CRC32C_KERNEL ? "" : " (not supported by this CPU)");
+
+    /* Throughput of each kernel */
+    bench ("table", &table_crc, buffer);
+    bench ("slice8", &slice_by_8, buffer);
+    if (KERNEL)
+        bench (FOLD_KERNEL_NAME, KERNEL, buffer);
+    bench ("compute", &public_crc, buffer);
+    bench ("slice8-c", &crc32c_slice_by_8, buffer);
+    if (CRC32C_KERNEL)
+        bench (CRC32C_KERNEL_NAME, CRC32C_KERNEL, buffer);
+    bench ("compute-c", &public_crc32c, buffer);
+
+    return FAILURES == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,41 @@
+#
+# Copyright (c) 2016 Alex Spataru
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+#
+# Standalone benchmark of the area-averaging downscaler, this target is not
+# part of QCCTV.pro, build it with "qmake tests/tests.pro && make"
+#
+
+TEMPLATE = app
+TARGET = downscale-bench
+
+QT += core
+QT += gui
+CONFIG += console
+CONFIG -= app_bundle
+
+OBJECTS_DIR = obj
+
+include ($$PWD/../../common/lib/yuv2rgb/yuv2rgb.pri)
+include ($$PWD/../../common/lib/downscale/downscale.pri)
+
+SOURCES += $$PWD/main.cpp
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2016 Alex Spataru
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE
+ */
+
+/*
+ * Compares the area-averaging downscaler with QImage::scaled on a synthetic
+ * 1280x960 scene with fine detail and noise. For every rung of the ladder,
+ * this program prints the best time of each filter and the size of the JPEG
+ * image (at quality 60) generated from its output.
+ *
+ * The output of the downscaler is also compared with an exact (floating
+ * point) box filter, on every rung of the scene and on random noise at the
+ * 2:1 and 4:1 ratios handled by the box kernels. This program returns a
+ * non-zero exit code if any pixel differs by more than one level.
+ *
+ * Build it with qmake and run it on the target device, the results of the
+ * SIMD kernels depend heavily on the CPU.
+ */
+
+#include <QtMath>
+#include <QImage>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "downscale.h"
+
+#define ITERATIONS 100
+#define CHECKS     2000
+#define MAX_ERROR  1.0
+
+/**
+ * Generates a scene with gradients, high frequency stripes, hard edges and
+ * some sensor noise, which is what makes nearest-neighbour scaling alias
+ */
+static QImage createScene (const int width, const int height)
+{
+    QImage image (width, height, QImage::Format_RGB888);
+
+    qsrand (1);
+    for (int y = 0; y < height; ++y) {
+        uchar* line = image.scanLine (y);
+        for (int x = 0; x < width; ++x) {
+            qreal v = 128 + 30 * qSin (y * 1.3) +
+                      60 * qSin (x * 0.9 + y * 0.05) * (x > width / 3 ? 1 : 0.2);
+
+            if ((((x / 40) + (y / 40)) % 2) && y > height / 2)
+                v = 255 - v;
+
+            for (int c = 0; c < 3; ++c) {
+                qreal p = v * (0.6 + 0.2 * c) + (x * 60.0 / width) + (qrand() % 9 - 4);
+                line[x * 3 + c] = (uchar) qBound (0.0, p, 255.0);
+            }
+        }
+    }
+
+    return image;
+}
+
+/**
+ * Downscales the \a source image to the given \a size with the
+ * area-averaging filter used by \c QCCTV_ScaleImage
+ */
+static QImage areaScaled (const QImage& source, const QSize& size,
+                          const int channels)
+{
+    QImage scaled (size, source.format());
+    area_downscale (scaled.bits(),
+                    scaled.width(),
+                    scaled.height(),
+                    scaled.bytesPerLine(),
+                    source.constBits(),
+                    source.width(),
+                    source.height(),
+                    source.bytesPerLine(),
+                    channels);
+
+    return scaled;
+}
+
+/**
+ * Returns the largest difference between the \a scaled image and the
+ * average of the \a source pixels covered by each of its pixels
+ */
+static qreal maxError (const QImage& scaled, const QImage& source,
+                       const int channels)
+{
+    const qreal sx = (qreal) source.width() / scaled.width();
+    const qreal sy = (qreal) source.height() / scaled.height();
+
+    qreal error = 0;
+    for (int y = 0; y < scaled.height(); ++y) {
+        const qreal y0 = y * sy;
+        const qreal y1 = (y + 1) * sy;
+        const uchar* line = scaled.constScanLine (y);
+
+        for (int x = 0; x < scaled.width(); ++x) {
+            const qreal x0 = x * sx;
+            const qreal x1 = (x + 1) * sx;
+
+            for (int c = 0; c < channels; ++c) {
+                qreal sum = 0;
+                for (int j = (int) y0; j < y1; ++j) {
+                    const qreal wy = qMin (y1, j + 1.0) - qMax (y0, (qreal) j);
+                    const uchar* src = source.constScanLine (j);
+
+                    for (int i = (int) x0; i < x1; ++i) {
+                        const qreal wx = qMin (x1, i + 1.0) - qMax (x0, (qreal) i);
+                        sum += wx * wy * src[i * channels + c];
+                    }
+                }
+
+                const qreal value = sum / (sx * sy);
+                error = qMax (error, qAbs (line[x * channels + c] - value));
+            }
+        }
+    }
+
+    return error;
+}
+
+/**
+ * Downscales random noise images of random sizes by 2:1 and 4:1 (which use
+ * the box kernels) and returns the largest error of the results
+ */
+static qreal checkBoxFilter()
+{
+    const QImage::Format formats[] = {
+        QImage::Format_Grayscale8,
+        QImage::Format_RGB888,
+        QImage::Format_RGB32
+    };
+    const int channels[] = { 1, 3, 4 };
+
+    qsrand (2);
+    qreal error = 0;
+    for (int i = 0; i < CHECKS; ++i) {
+        const int format = qrand() % 3;
+        const int factor = (qrand() % 2) ? 2 : 4;
+        const QSize size (1 + qrand() % 80, 1 + qrand() % 20);
+
+        QImage source (size.width() * factor, size.height() * factor,
+                       formats[format]);
+        for (int y = 0; y < source.height(); ++y) {
+            uchar* line = source.scanLine (y);
+            for (int x = 0; x < source.bytesPerLine(); ++x)
+                line[x] = qrand() & 0xFF;
+        }
+
+        const QImage scaled = areaScaled (source, size, channels[format]);
+        error = qMax (error, maxError (scaled, source, channels[format]));
+    }
+
+    return error;
+}
+
+/**
+ * Returns the size of the given \a image encoded as a JPEG
+ */
+static int jpegSize (const QImage& image)
+{
+    QByteArray data;
+    QBuffer buffer (&data);
+    buffer.open (QIODevice::WriteOnly);
+    image.save (&buffer, "jpg", 60);
+    return data.length();
+}
+
+int main (int argc, char* argv[])
+{
+    QCoreApplication app (argc, argv);
+
+    const QImage source = createScene (1280, 960);
+    const QSize sizes[] = {
+        QSize (960, 720),
+        QSize (640, 480),
+        QSize (320, 240),
+        QSize (176, 132)
+    };
+
+    printf ("%-10s %10s %10s %10s %10s %10s %10s %10s\n", "rung",
+            "fast ms", "smooth ms", "area ms",
+            "fast jpg", "smooth jpg", "area jpg", "area err");
+
+    qreal error = 0;
+
+    for (unsigned i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i) {
+        const QSize size = sizes[i];
+        QImage fast, smooth, area;
+        qint64 fastTime = -1;
+        qint64 smoothTime = -1;
+        qint64 areaTime = -1;
+
+        /* Keep the best time of each filter */
+        QElapsedTimer timer;
+        for (int j = 0; j < ITERATIONS; ++j) {
+            timer.start();
+            fast = source.scaled (size, Qt::IgnoreAspectRatio,
+                                  Qt::FastTransformation);
+            qint64 time = timer.nsecsElapsed();
+            if (fastTime < 0 || time < fastTime)
+                fastTime = time;
+
+            timer.start();
+            smooth = source.scaled (size, Qt::IgnoreAspectRatio,
+                                    Qt::SmoothTransformation);
+            time = timer.nsecsElapsed();
+            if (smoothTime < 0 || time < smoothTime)
+                smoothTime = time;
+
+            timer.start();
+            area = areaScaled (source, size, 3);
+            time = timer.nsecsElapsed();
+            if (areaTime < 0 || time < areaTime)
+                areaTime = time;
+        }
+
+        const qreal areaError = maxError (area, source, 3);
+        error = qMax (error, areaError);
+
+        printf ("%4dx%-5d %10.3f %10.3f %10.3f %10d %10d %10d %10.2f\n",
+                size.width(), size.height(),
+                fastTime / 1e6, smoothTime / 1e6, areaTime / 1e6,
+                jpegSize (fast), jpegSize (smooth), jpegSize (area),
+                areaError);
+    }
+
+    const qreal boxError = checkBoxFilter();
+    printf ("\nbox filter error on noise (2:1 and 4:1): %.2f\n", boxError);
+
+    if (qMax (error, boxError) > MAX_ERROR) {
+        printf ("FAIL: the error exceeds %.2f\n", MAX_ERROR);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}